@@ -11,6 +11,7 @@
 
 #define _USE_MATH_DEFINES
 #include <cmath>
+#include <algorithm>
 #include "ADSR.h"
 
 // constexpr float BITDEPTH = 16;// |
@@ -20,6 +21,9 @@
 constexpr float EXP_DECAY = (float)(M_LN10 * 96/20);
 // SNR := 20*bits*ln(2); k := (ln(10)*SNR)/(20*t) => ln(10)*bits*ln(2)/t
 
+/// Seconds for a faded out (stolen) note to drop from full to 0
+constexpr float FADE_TIME = 0.005f;
+
 /**
 @brief
 	Get the linear decay factor for the given duration and sample rate
@@ -72,7 +76,8 @@ ADSR::ADSR(float a, float d, float s, float r, float R)
 	: current_mode(ATTACK), envelope(a == 0? 1.0f : 0),
 	sustain_level(s), attack_increment(linearDegradeRate(a, R, d, s)),
 	decay_factor(expDegradeRate(d, R)),
-	release_factor(expDegradeRate(r, R))
+	release_factor(expDegradeRate(r, R)),
+	fade_factor(expDegradeRate(FADE_TIME, R))
 {
 }
 
@@ -112,34 +117,117 @@ float ADSR::output(void)
 */
 void ADSR::next(void)
 {
-	switch (current_mode)
+	advance(envelope, current_mode);
+}
+
+/**
+@brief
+	Advance external envelope state a sample using this envelope's settings
+@param level
+  - Envelope amplitude of the state to be advanced in place
+@param mode
+  - Envelope mode of the state to be advanced in place
+*/
+void ADSR::advance(float& level, Mode& mode) const
+{
+	switch (mode)
+	{
+	case ATTACK:
+		level += attack_increment;
+		if (1.0 <= level)
+		{
+			level = 1.0;
+			mode = DECAY;
+		}
+		break;
+	case DECAY:
+		level *= decay_factor;
+		if (level <= sustain_level)
+		{
+			level = sustain_level;
+		}
+		break;
+	case SUSTAIN:
+		break;
+	case FADE:
+		level *= fade_factor;
+		break;
+	case RELEASE: default:
+		level *= release_factor;
+		break;
+	}
+}
+
+/**
+@brief
+	Get the factors each mode scales levels by over a count of samples, for
+	advancing many envelope states a block at a time
+@param samples
+  - Count of samples the span covers
+@return
+  - Decay, release & fade factors compounded once per sample
+*/
+ADSR::Span ADSR::span(unsigned samples) const
+{
+	Span result = { samples, (float)pow(decay_factor, (float)samples),
+		(float)pow(release_factor, (float)samples),
+		(float)pow(fade_factor, (float)samples) };
+	return result;
+}
+
+/**
+@brief
+	Advance external envelope state over a span of samples at once
+@param level
+  - Envelope amplitude of the state to be advanced in place
+@param mode
+  - Envelope mode of the state to be advanced in place
+@param span
+  - Factors over the count of samples to advance, from span()
+*/
+void ADSR::advance(float& level, Mode& mode, const Span& span) const
+{
+	unsigned attack;
+	switch (mode)
 	{
 	case ATTACK:
-		envelope += attack_increment;
-		if (1.0 <= envelope)
+		if (level + attack_increment * span.samples < 1.0f)
+		{
+			level += attack_increment * span.samples;
+			break;
+		}
+		// decay through the samples left once the attack peaks
+		attack = (unsigned)ceil((1.0f - level) / attack_increment);
+		level = (float)pow(decay_factor,
+			(float)(span.samples - std::min(attack, span.samples)));
+		mode = DECAY;
+		if (level <= sustain_level)
 		{
-			envelope = 1.0;
-			current_mode = DECAY;
+			level = sustain_level;
 		}
 		break;
 	case DECAY:
-		envelope *= decay_factor;
-		if (envelope <= sustain_level)
+		level *= span.decay;
+		if (level <= sustain_level)
 		{
-			envelope = sustain_level;
+			level = sustain_level;
 		}
 		break;
 	case SUSTAIN:
 		break;
+	case FADE:
+		level *= span.fade;
+		break;
 	case RELEASE: default:
-		envelope *= release_factor;
+		level *= span.release;
 		break;
 	}
 }
 
 /**
 @brief
-	Get the current time's envelope mode: { Attack, Decay, Sustain, Release }
+	Get the current time's envelope mode:
+	{ Attack, Decay, Sustain, Release, Fade }
 @return
     Mode of envelope's progressive change per sample currently in use
 */
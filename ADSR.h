@@ -8,12 +8,16 @@
 
 class ADSR {
   public:
-    enum Mode { ATTACK=0, DECAY=1, SUSTAIN=2, RELEASE=3 };
+    enum Mode { ATTACK=0, DECAY=1, SUSTAIN=2, RELEASE=3, FADE=4 };
+    struct Span { unsigned samples; float decay, release, fade; };
     ADSR(float a=0, float d=0, float s=1, float r=0, float R=44100);
     void sustainOff(void);
     void reset(void);
     float output(void);
     void next(void);
+    void advance(float& level, Mode& mode) const;
+    Span span(unsigned samples) const;
+    void advance(float& level, Mode& mode, const Span& span) const;
     Mode mode(void);
   private:
     Mode current_mode;
@@ -21,7 +25,8 @@ class ADSR {
           attack_increment,
           decay_factor,
           sustain_level,
-          release_factor;
+          release_factor,
+          fade_factor;
 };
 
 
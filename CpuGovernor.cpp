@@ -0,0 +1,67 @@
+/**
+@file
+  CpuGovernor.cpp
+@brief
+  Render time tracking against block deadlines, stepping quality levels
+@project
+  SP24CS245-A Assignment 9 (4/5/24)
+@author
+  Ari Surprise (a.surprise@digipen.edu | 0050207)
+*/
+
+#include "CpuGovernor.h" // Class header file
+
+/// Fraction of a block's deadline past which quality steps down a level
+constexpr float STEP_DOWN_LOAD = 0.75f;
+
+/// Fraction of a block's deadline under which a block counts as calm
+constexpr float STEP_UP_LOAD = 0.4f;
+
+/// Consecutive calm blocks before quality steps back up a level
+constexpr unsigned RECOVER_BLOCKS = 64;
+
+CpuGovernor::CpuGovernor(float R)
+  : rate(R), calm(0), current(FULL), overrun_count(0), last_load(0)
+{
+}
+
+void CpuGovernor::measure(double seconds, unsigned long frames)
+{
+  int level = current.load(std::memory_order_relaxed);
+  float load = (frames == 0) ? 0 : (float)(seconds * rate / frames);
+  last_load.store(load, std::memory_order_relaxed);
+  if (1 < load)
+  {
+    overrun_count.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (STEP_DOWN_LOAD < load)
+  {
+    calm = 0;
+    if (level + 1 < LEVELS)
+    {
+      current.store(level + 1, std::memory_order_relaxed);
+    }
+    return;
+  }
+  calm = (load < STEP_UP_LOAD) ? calm + 1 : 0;
+  if (RECOVER_BLOCKS <= calm && FULL < level)
+  {
+    calm = 0;
+    current.store(level - 1, std::memory_order_relaxed);
+  }
+}
+
+CpuGovernor::Level CpuGovernor::level(void) const
+{
+  return (Level)current.load(std::memory_order_relaxed);
+}
+
+unsigned long CpuGovernor::overruns(void) const
+{
+  return overrun_count.load(std::memory_order_relaxed);
+}
+
+float CpuGovernor::load(void) const
+{
+  return last_load.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,91 @@
+/**
+@file
+  CpuGovernor.h
+@brief
+  Render time tracking against block deadlines, stepping quality levels
+@project
+  SP24CS245-A Assignment 9 (4/5/24)
+@author
+  Ari Surprise (a.surprise@digipen.edu | 0050207)
+*/
+
+#ifndef CS245_CPUGOVERNOR_H
+#define CS245_CPUGOVERNOR_H
+
+#include <atomic> // Level & counters read by threads other than the renderer
+
+/// Quality level picked from how much of each block's deadline rendering uses
+class CpuGovernor {
+  public:
+    /// Quality levels of rendering, from full quality down to cheapest
+    enum Level
+    {
+      FULL, /// Full quality rendering
+      NEAREST, /// Notes read nearest samples rather than interpolating
+      CULL_TAILS, /// Release tails are cut off at a higher level
+      FEWER_NOTES, /// Polyphony halved, quietest notes past it fade
+      LEVELS, /// Count of quality levels
+    };
+
+    /**
+    @brief
+      Initialize at full quality with no overruns counted
+    @param R
+      - Samples per second blocks are rendered for, giving their deadlines
+    */
+    explicit CpuGovernor(float R = 44100.0f);
+
+    /**
+    @brief
+      Account for a rendered block, stepping quality down a level when its
+      render time nears the deadline, or up after sustained headroom
+      (render thread only)
+    @param seconds
+      - Time taken to render the block
+    @param frames
+      - Count of frames in the block
+    */
+    void measure(double seconds, unsigned long frames);
+
+    /**
+    @brief
+      Get the quality level rendering is to use
+    @return
+      - Level from FULL (0) to FEWER_NOTES
+    */
+    Level level(void) const;
+
+    /**
+    @brief
+      Get the count of blocks that took longer to render than they last
+    @return
+      - Blocks rendered past their deadline since construction
+    */
+    unsigned long overruns(void) const;
+
+    /**
+    @brief
+      Get the fraction of its deadline the last block took to render
+    @return
+      - Render time over block duration (above 1 is an overrun)
+    */
+    float load(void) const;
+
+  private:
+    /// Samples per second blocks are rendered for
+    float rate;
+
+    /// Consecutive blocks rendered with headroom to step quality back up
+    unsigned calm;
+
+    /// Quality level rendering is to use
+    std::atomic<int> current;
+
+    /// Blocks rendered past their deadline
+    std::atomic<unsigned long> overrun_count;
+
+    /// Fraction of its deadline the last block took to render
+    std::atomic<float> last_load;
+};
+
+#endif
@@ -0,0 +1,46 @@
+/**
+@file
+  DenormalGuard.cpp
+@brief
+  Scoped flush to zero (FTZ) & denormals are zero (DAZ) floating point mode
+@project
+  SP24CS245-A Assignment 9 (4/5/24)
+@author
+  Ari Surprise (a.surprise@digipen.edu | 0050207)
+*/
+
+#include "DenormalGuard.h" // Class header file
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP)
+#include <xmmintrin.h> // _mm_getcsr, _mm_setcsr of the SSE control register
+#define DENORMALGUARD_SSE
+/// MXCSR flush to zero (bit 15) & denormals are zero (bit 6) flags
+constexpr unsigned FTZ_DAZ = 0x8040;
+#elif defined(__aarch64__)
+#define DENORMALGUARD_ARM64
+/// FPCR flush to zero flag (bit 24), also treating denormal inputs as 0
+constexpr unsigned long long FTZ_DAZ = 1ull << 24;
+#endif
+
+DenormalGuard::DenormalGuard(void)
+  : saved(0)
+{
+#if defined(DENORMALGUARD_SSE)
+  saved = _mm_getcsr();
+  _mm_setcsr((unsigned)saved | FTZ_DAZ);
+#elif defined(DENORMALGUARD_ARM64)
+  unsigned long long mode;
+  __asm__ __volatile__("mrs %0, fpcr" : "=r"(mode));
+  saved = mode;
+  mode |= FTZ_DAZ;
+  __asm__ __volatile__("msr fpcr, %0" : : "r"(mode));
+#endif
+}
+
+DenormalGuard::~DenormalGuard(void)
+{
+#if defined(DENORMALGUARD_SSE)
+  _mm_setcsr((unsigned)saved);
+#elif defined(DENORMALGUARD_ARM64)
+  __asm__ __volatile__("msr fpcr, %0" : : "r"(saved));
+#endif
+}
@@ -0,0 +1,40 @@
+/**
+@file
+  DenormalGuard.h
+@brief
+  Scoped flush to zero (FTZ) & denormals are zero (DAZ) floating point mode
+@project
+  SP24CS245-A Assignment 9 (4/5/24)
+@author
+  Ari Surprise (a.surprise@digipen.edu | 0050207)
+*/
+
+#ifndef CS245_DENORMALGUARD_H
+#define CS245_DENORMALGUARD_H
+
+/// Treats denormal floats as 0 on the constructing thread while in scope, so
+/// levels decaying toward 0 never hit the slow denormal arithmetic path
+class DenormalGuard {
+  public:
+    /**
+    @brief
+      Save the thread's floating point mode and set FTZ & DAZ (no-op where
+      the platform has no such control)
+    */
+    DenormalGuard(void);
+
+    /**
+    @brief
+      Restore the thread's floating point mode saved on construction
+    */
+    ~DenormalGuard(void);
+
+  private:
+    DenormalGuard(const DenormalGuard&) = delete;
+    DenormalGuard& operator=(const DenormalGuard&) = delete;
+
+    /// Floating point control state saved on construction
+    unsigned long long saved;
+};
+
+#endif
@@ -0,0 +1,91 @@
+/**
+@file
+  EventQueue.h
+@brief
+  Wait-free single producer, single consumer ring buffer of events
+@project
+  SP24CS245-A Assignment 9 (4/5/24)
+@author
+  Ari Surprise (a.surprise@digipen.edu | 0050207)
+*/
+
+#ifndef CS245_EVENTQUEUE_H
+#define CS245_EVENTQUEUE_H
+
+#include <atomic> // Indices published between producer & consumer threads
+
+/// Fixed capacity FIFO handing items from one thread to one other thread
+template <typename T, unsigned N>
+class EventQueue {
+  public:
+
+    /**
+    @brief
+      Initialize an empty queue
+    */
+    EventQueue(void) : head(0), tail(0)
+    {
+    }
+
+    /**
+    @brief
+      Append an item to the queue (producer thread only)
+    @param item
+      - Value copied into the queue for the consumer to pop
+    @return
+      - true if queued, false if the queue was full and the item dropped
+    */
+    bool push(const T& item)
+    {
+      unsigned back = tail.load(std::memory_order_relaxed);
+      if (back - head.load(std::memory_order_acquire) == N) { return false; }
+      items[back & (N - 1)] = item;
+      tail.store(back + 1, std::memory_order_release);
+      return true;
+    }
+
+    /**
+    @brief
+      Get the oldest queued item without removing it (consumer thread only)
+    @return
+      - Address of the oldest item, or null while the queue is empty
+    */
+    const T* front(void) const
+    {
+      unsigned next = head.load(std::memory_order_relaxed);
+      if (next == tail.load(std::memory_order_acquire)) { return 0; }
+      return &items[next & (N - 1)];
+    }
+
+    /**
+    @brief
+      Remove the oldest item from the queue (consumer thread only)
+    @param item
+      - Set to the value of the oldest item when one is queued
+    @return
+      - true if an item was removed, false if the queue was empty
+    */
+    bool pop(T& item)
+    {
+      const T* next = front();
+      if (!next) { return false; }
+      item = *next;
+      head.store(head.load(std::memory_order_relaxed) + 1,
+        std::memory_order_release);
+      return true;
+    }
+
+  private:
+    static_assert(N != 0 && (N & (N - 1)) == 0, "N must be a power of 2");
+
+    /// Ring buffer of queued items, indexed modulo N
+    T items[N];
+
+    /// Count of items ever popped; written only by the consumer
+    alignas(64) std::atomic<unsigned> head;
+
+    /// Count of items ever pushed; written only by the producer
+    alignas(64) std::atomic<unsigned> tail;
+};
+
+#endif
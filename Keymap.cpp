@@ -0,0 +1,142 @@
+/**
+@file
+  Keymap.cpp
+@brief
+  Instrument zones loaded from a text file, flattened for O(1) note lookup
+@project
+  SP24CS245-A Assignment 9 (4/5/24)
+@author
+  Ari Surprise (a.surprise@digipen.edu | 0050207)
+*/
+
+#include <algorithm> // std::fill, std::replace of unmapped programs
+#include <fstream> // Keymap text file reading
+#include <map> // Sample pool & alternate run lookup while loading
+#include <sstream> // Field parsing per line & error messages
+#include <stdexcept> // std::runtime_error for missing or malformed input
+#include <string> // Lines & sample file names read
+#include "Keymap.h" // Class header file
+
+/// Marks a program with nothing mapped to it
+constexpr int UNMAPPED = -1;
+
+/// Zone line fields ahead of its flattening into the lookup tables
+struct Range
+{
+  int program, key_lo, key_hi, vel_lo, vel_hi;
+};
+
+/**
+@brief
+  Check a range read from a keymap line is ordered & within [0, limit)
+@param lo
+  - First value of the range
+@param hi
+  - Last value of the range
+@param limit
+  - Count of values addressable
+@return
+  - True where the range is valid
+*/
+static bool inRange(int lo, int hi, int limit)
+{
+  return 0 <= lo && lo <= hi && hi < limit;
+}
+
+Keymap::Keymap(const char* path)
+{
+  std::ifstream file(path);
+  std::string line, name;
+  std::vector<Range> ranges;
+  std::vector<std::vector<unsigned>> covering;
+  std::map<std::string, const AudioData*> pool;
+  std::map<std::vector<unsigned>, Cell> runs;
+  std::stringstream message;
+  int number = 0, mapped = 0, lowest = UNMAPPED, i, key, vel, cell;
+  if (!file)
+  {
+    message << "keymap '" << path << "' not found";
+    throw std::runtime_error(message.str());
+  }
+  std::fill(programs, programs + PROGRAMS, UNMAPPED);
+  while (std::getline(file, line))
+  {
+    std::istringstream fields(line);
+    Range range;
+    Zone zone;
+    ++number;
+    if (!(fields >> name) || name[0] == '#') { continue; }
+    fields.clear();
+    fields.seekg(0);
+    if (!(fields >> range.program >> name >> zone.speed >> zone.first
+      >> zone.last >> range.key_lo >> range.key_hi >> range.vel_lo
+      >> range.vel_hi) || !inRange(range.program, range.program, PROGRAMS)
+      || !inRange(range.key_lo, range.key_hi, KEYS)
+      || !inRange(range.vel_lo, range.vel_hi, VELOCITIES))
+    {
+      message << "keymap '" << path << "' line " << number << " malformed";
+      throw std::runtime_error(message.str());
+    }
+    const AudioData*& source = pool[name];
+    if (!source)
+    {
+      samples.emplace_back(new AudioData(name.c_str()));
+      source = samples.back().get();
+    }
+    zone.source = source;
+    zone.channel = 0;
+    zones.push_back(zone);
+    ranges.push_back(range);
+    if (programs[range.program] == UNMAPPED)
+    {
+      programs[range.program] = mapped++ * KEYS * VELOCITIES;
+    }
+  }
+  if (zones.empty())
+  {
+    message << "keymap '" << path << "' has no zones";
+    throw std::runtime_error(message.str());
+  }
+  // Gather the zones covering each entry in file order, then flatten each
+  // distinct set of alternates once, shared by every entry it covers
+  covering.resize(mapped * KEYS * VELOCITIES);
+  for (i = 0; i < (int)ranges.size(); ++i)
+  {
+    const Range& range = ranges[i];
+    for (key = range.key_lo; key <= range.key_hi; ++key)
+    {
+      for (vel = range.vel_lo; vel <= range.vel_hi; ++vel)
+      {
+        cell = programs[range.program] + key * VELOCITIES + vel;
+        covering[cell].push_back((unsigned)i);
+      }
+    }
+  }
+  table.resize(covering.size());
+  for (cell = 0; cell < (int)covering.size(); ++cell)
+  {
+    auto run = runs.find(covering[cell]);
+    if (run == runs.end())
+    {
+      Cell added = { (unsigned)alternates.size(),
+        (unsigned)covering[cell].size() };
+      alternates.insert(alternates.end(), covering[cell].begin(),
+        covering[cell].end());
+      run = runs.insert(std::make_pair(covering[cell], added)).first;
+    }
+    table[cell] = run->second;
+  }
+  for (i = 0; i < PROGRAMS && lowest == UNMAPPED; ++i)
+  {
+    lowest = programs[i];
+  }
+  std::replace(programs, programs + PROGRAMS, UNMAPPED, lowest);
+}
+
+const Keymap::Zone* Keymap::find(int program, int key, int velocity,
+  unsigned turn) const
+{
+  const Cell& cell = table[programs[program] + key * VELOCITIES + velocity];
+  if (cell.count == 0) { return nullptr; }
+  return &zones[alternates[cell.first + turn % cell.count]];
+}
@@ -0,0 +1,101 @@
+/**
+@file
+  Keymap.h
+@brief
+  Instrument zones loaded from a text file, flattened for O(1) note lookup
+@project
+  SP24CS245-A Assignment 9 (4/5/24)
+@author
+  Ari Surprise (a.surprise@digipen.edu | 0050207)
+*/
+
+#ifndef CS245_KEYMAP_H
+#define CS245_KEYMAP_H
+
+#include "AudioData.h" // Sampled waveforms zones resample
+#include <memory> // Pooled samples owned with stable addresses
+#include <vector> // Zone, sample & lookup table storage sized on load
+
+/// Program × key × velocity map of the sampled zone a note plays
+class Keymap {
+  public:
+    /// Count of midi programs, keys and velocities a keymap can address
+    static const int PROGRAMS = 128;
+    static const int KEYS = 128;
+    static const int VELOCITIES = 128;
+
+    /// Sample and resampling context a range of keys & velocities plays
+    struct Zone
+    {
+      /// Loaded audio file resampled to play the zone's notes
+      const AudioData* source;
+
+      /// Channel of the source audio data read
+      unsigned channel;
+
+      /// First sample of the looped portion of the source audio data
+      unsigned first;
+
+      /// Last sample of the looped portion of the source audio data
+      unsigned last;
+
+      /// Frames advanced per sample to have the source sound at 440 Hz
+      float speed;
+    };
+
+    /**
+    @brief
+      Load a keymap file, with every sample it names, and build the lookup
+      tables. Lines are blank, # comments, or zones of whitespace separated
+        program file speed loop_first loop_last key_lo key_hi vel_lo vel_hi
+      where velocity layers are zones of a key with disjoint velocity ranges,
+      and zones overlapping on a key & velocity are round-robin alternates
+      (in file order). Each file is loaded once, however many zones play it.
+      Programs with no zones play the lowest numbered program mapped.
+    @param path
+      - File name/path of the keymap text file
+    @throw std::runtime_error
+      - Where the file or a sample it names is missing or malformed
+    */
+    explicit Keymap(const char* path);
+
+    /**
+    @brief
+      Look up the zone a note plays (one indexed load per table)
+    @param program
+      - [0,127] program/patch of the channel the note is played on
+    @param key
+      - [0,127] midi key of the note
+    @param velocity
+      - [0,127] midi velocity of the note
+    @param turn
+      - Round-robin count of the key, selecting among alternate zones
+    @return
+      - Zone to play, else nullptr where no zone covers the key & velocity
+    */
+    const Zone* find(int program, int key, int velocity, unsigned turn) const;
+
+  private:
+    /// Run of round-robin alternates (within alternates) a note may play
+    struct Cell
+    {
+      unsigned first, count;
+    };
+
+    /// Loaded audio files, one per distinct file name shared by its zones
+    std::vector<std::unique_ptr<AudioData>> samples;
+
+    /// Zones in the order loaded
+    std::vector<Zone> zones;
+
+    /// Zone indices of each distinct run of round-robin alternates
+    std::vector<unsigned> alternates;
+
+    /// Per mapped program, KEYS × VELOCITIES alternate runs (0 count: none)
+    std::vector<Cell> table;
+
+    /// Index of each program's lookup table within table
+    int programs[PROGRAMS];
+};
+
+#endif
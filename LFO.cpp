@@ -0,0 +1,65 @@
+/**
+@file
+  LFO.cpp
+@brief
+  Low frequency sine oscillator read from a wavetable at control rate
+@project
+  SP24CS245-A Assignment 9 (4/5/24)
+@author
+  Ari Surprise (a.surprise@digipen.edu | 0050207)
+*/
+
+#define _USE_MATH_DEFINES
+#include <cmath> // sin to fill the wavetable, floor for phase wrapping
+#include "LFO.h" // Class header file
+
+/// Count of wavetable entries per sine cycle (power of 2)
+constexpr unsigned TABLE_SIZE = 256;
+
+/// Single sine cycle, with a guard entry repeating the first for lerping
+struct SineTable
+{
+  SineTable(void)
+  {
+    unsigned i;
+    for (i = 0; i <= TABLE_SIZE; ++i)
+    {
+      value[i] = (float)sin(2.0 * M_PI * i / TABLE_SIZE);
+    }
+  }
+  float value[TABLE_SIZE + 1];
+};
+
+/**
+@brief
+  Get the wavetable shared by every oscillator (built on first use)
+@return
+  - TABLE_SIZE + 1 samples of one sine cycle
+*/
+static const float* sineTable(void)
+{
+  static const SineTable table;
+  return table.value;
+}
+
+LFO::LFO(float frequency, float R)
+  : phase(0), increment((R == 0) ? 0 : frequency / R)
+{
+  sineTable();
+}
+
+float LFO::next(unsigned samples)
+{
+  phase += increment * samples;
+  phase -= floor(phase);
+  return output();
+}
+
+float LFO::output(void) const
+{
+  const float* table = sineTable();
+  double index = phase * TABLE_SIZE;
+  unsigned i = (unsigned)index;
+  float t = (float)(index - i);
+  return table[i] + (table[i + 1] - table[i]) * t;
+}
@@ -0,0 +1,55 @@
+/**
+@file
+  LFO.h
+@brief
+  Low frequency sine oscillator read from a wavetable at control rate
+@project
+  SP24CS245-A Assignment 9 (4/5/24)
+@author
+  Ari Surprise (a.surprise@digipen.edu | 0050207)
+*/
+
+#ifndef CS245_LFO_H
+#define CS245_LFO_H
+
+/// Sinusoidal modulation source advanced a block of samples at a time
+class LFO {
+  public:
+
+    /**
+    @brief
+      Initialize the oscillator at phase 0
+    @param frequency
+      - Cycles per second of the oscillation
+    @param R
+      - Samples per second the oscillator is advanced by
+    */
+    LFO(float frequency = 5.0f, float R = 44100.0f);
+
+    /**
+    @brief
+      Advance the oscillator by a count of samples
+    @param samples
+      - Count of samples elapsed since the last call
+    @return
+      - [-1,1] value of the oscillator after the samples have elapsed
+    */
+    float next(unsigned samples);
+
+    /**
+    @brief
+      Get the value of the oscillator at its current phase
+    @return
+      - [-1,1] value of the oscillator
+    */
+    float output(void) const;
+
+  private:
+    /// Fraction [0,1) of a cycle the oscillator has progressed through
+    double phase;
+
+    /// Fraction of a cycle progressed per sample
+    double increment;
+};
+
+#endif
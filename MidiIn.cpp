@@ -12,6 +12,15 @@
 */
 #include "MidiIn.h"
 #include <stdexcept>
+#include <chrono>
+#include <algorithm>
+
+/// Shortest sleep between polls finding no input, taken after any input
+constexpr std::chrono::microseconds MIN_WAIT(100);
+/// Longest sleep between polls, bounding how late input is noticed
+constexpr std::chrono::microseconds MAX_WAIT(1000);
+/// Events buffered by the input stream, & so read at most per poll
+constexpr int INPUT_BUFFER = 64;
 
 /**
 @brief
@@ -35,72 +44,181 @@ std::string MidiIn::getDeviceInfo(void)
 /**
 @brief
   Poll midi events after start() is called (thread requiring a static fn w/data)
+  Each poll reads up to INPUT_BUFFER events, so bursts drain in one wake up.
+  Sleeps while stopped, & per the wait strategy between polls finding no input
+  (doubling from MIN_WAIT to MAX_WAIT while idle), tracking the longest time
+  between polls as the worst case latency of noticing an event
 @param midiin_ptr
   - MidiIn (pointer) launching the thread, to pass in for parent manipulation
 */
 void MidiIn::eventLoop(MidiIn* midiin_ptr)
 {
-    constexpr float ratio16Bit = 2.0f / ((1 << 14) - 1);
+    typedef std::chrono::steady_clock clock;
+    PmEvent events[INPUT_BUFFER];
+    int count;
+    std::chrono::microseconds wait = MIN_WAIT;
+    clock::time_point polled = clock::now(), now;
     while (midiin_ptr->thread_running)
     {
-        // Check that polling has been set to start()
-        if (midiin_ptr->process_events)
+        // Block until start() or destruction rather than spin while stopped
+        if (!midiin_ptr->process_events)
+        {
+            std::unique_lock<std::mutex> lock(midiin_ptr->wake_lock);
+            midiin_ptr->wake.wait(lock, [midiin_ptr] {
+                return midiin_ptr->process_events
+                    || !midiin_ptr->thread_running;
+            });
+            polled = clock::now();
+            continue;
+        }
+        now = clock::now();
+        double latency = std::chrono::duration<double>(now - polled).count();
+        if (midiin_ptr->max_latency < latency)
+        {
+            midiin_ptr->max_latency = latency;
+        }
+        polled = now;
+        // Drain up to a buffer's worth of messages per wake up
+        count = Pm_Read(midiin_ptr->input_stream, events, INPUT_BUFFER);
+        for (int i = 0; i < count; ++i)
+        {
+            midiin_ptr->dispatch(events[i].message);
+        }
+        if (0 < count)
+        {
+            wait = MIN_WAIT;
+        }
+        else if (midiin_ptr->wait_strategy == BACKOFF)
+        {
+            std::this_thread::sleep_for(wait);
+            wait = std::min(wait * 2, MAX_WAIT);
+        }
+    }
+}
+
+/**
+@brief
+  Channel voice message handlers, indexed by status nibble less 8 (null where
+  the message is recognized but unused)
+@param midiin
+  - MidiIn receiving the message
+@param channel
+  - Channel of the message
+@param b1, b2
+  - Data bytes of the message
+*/
+static void noteOff(MidiIn& midiin, int channel, int b1, int b2)
+{
+    midiin.onNoteOff(channel, b1);
+}
+
+static void noteOn(MidiIn& midiin, int channel, int b1, int b2)
+{
+    if (b2 == 0) // 0 velocity note on => note off
+    {
+        midiin.onNoteOff(channel, b1);
+        return;
+    }
+    midiin.onNoteOn(channel, b1, b2);
+}
+
+static void controlChange(MidiIn& midiin, int channel, int b1, int b2)
+{
+    switch (b1) // added functions along control_num
+    {
+    case 1: // ModWheel
+        midiin.onModulationWheelChange(channel, b2);
+        break;
+    case 7: // Channel Volume
+        midiin.onVolumeChange(channel, b2);
+        break;
+    }
+    midiin.onControlChange(channel, b1, b2);
+}
+
+static void programChange(MidiIn& midiin, int channel, int b1, int b2)
+{
+    midiin.onPatchChange(channel, b1);
+}
+
+static void pitchWheel(MidiIn& midiin, int channel, int b1, int b2)
+{
+    constexpr float ratio16Bit = 2.0f / ((1 << 14) - 1);
+    int b12 = (((b2 << 7) + b1) - (1 << 13)); // 14bit combined val
+    midiin.onPitchWheelChange(channel, (b12 * ratio16Bit));
+}
+
+static void (* const VOICE_MESSAGES[])(MidiIn&, int, int, int) = {
+    noteOff,       // 0x8 NoteOff(key)
+    noteOn,        // 0x9 NoteOn(key, velocity)
+    nullptr,       // 0xA ~PolyKeyPressure(aftertouch_pressure)
+    controlChange, // 0xB ControlChange(control_num, value)
+    programChange, // 0xC ProgramChange(prog_num)
+    nullptr,       // 0xD ~ChannelPressure(aftertouch_pressure)
+    pitchWheel     // 0xE PitchWheel(LSB+MSB)
+};
+
+/**
+@brief
+  Decode a midi message & call its handler, never throwing: realtime bytes
+  (clock, active sensing, etc) & sysex data are skipped, data bytes without a
+  status byte reuse the last (running) status, & messages that can't be
+  decoded are counted as unknown
+@param message
+  - Status byte & up to 3 data bytes packed from least significant byte up
+*/
+void MidiIn::dispatch(PmMessage message)
+{
+    int byte[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        byte[i] = (message >> (8 * i)) & 0xFF;
+    }
+    int status = byte[0], b1 = byte[1], b2 = byte[2];
+    // Sysex data continues until its end (or any other non-realtime status)
+    if (in_sysex && (status < 0x80 || 0xF7 <= status))
+    {
+        for (int i = 0; i < 4 && in_sysex; ++i)
+        {
+            in_sysex = byte[i] != 0xF7;
+        }
+        return;
+    }
+    in_sysex = false;
+    if (0xF8 <= status) // realtime, leaving running status alone
+    {
+        return;
+    }
+    if (0xF0 <= status) // system common, cancelling running status
+    {
+        running_status = 0;
+        if (status == 0xF0) // sysex start, possibly ending in this message
+        {
+            in_sysex = b1 != 0xF7 && b2 != 0xF7 && byte[3] != 0xF7;
+        }
+        else if (status == 0xF4 || status == 0xF5) // undefined
+        {
+            ++unknown_messages;
+        }
+        return;
+    }
+    if (status < 0x80) // data bytes under running status
+    {
+        if (!running_status)
         {
-            // Check for any message
-            if (Pm_Poll(midiin_ptr->input_stream)) {
-                // Fetch & process the message
-                union {
-                    long signal;
-                    unsigned char byte[4];
-                } data;
-                PmEvent event;
-                Pm_Read(midiin_ptr->input_stream, &event, 1);
-                data.signal = event.message;
-                short cmd_n = data.byte[0] >> 4, // [0]nibble[0]
-                    channel = data.byte[0] & 0x0F, // [0]nibble[1]
-                    b1 = data.byte[1] & 0x7F,
-                    b2 = data.byte[2] & 0x7F,
-                    b12 = (((b2 << 7) + b1) - (1 << 13)); // 14bit combined val
-                // Process signal per command number from byte[0]
-                switch (cmd_n)
-                {
-                case 0x8: // NoteOff(key)
-                    midiin_ptr->onNoteOff(channel, b1);
-                    break;
-                case 0x9: // NoteOn(key, velocity)
-                    if (b2 == 0) // 0 velocity note on => note off
-                    {
-                        midiin_ptr->onNoteOff(channel, b1);
-                        break;
-                    }
-                    midiin_ptr->onNoteOn(channel, b1, b2);
-                    break;
-              //case 0xA: // ~PolyKeyPressure(aftertouch_pressure)
-                case 0xB: // ControlChange(control_num, value)
-                    switch (b1) // added functions along control_num
-                    {
-                    case 1: // ModWheel
-                        midiin_ptr->onModulationWheelChange(channel, b2);
-                        break;
-                    case 7: // Channel Volume
-                        midiin_ptr->onVolumeChange(channel, b2);
-                        break;
-                    }
-                    midiin_ptr->onControlChange(channel, b1, b2);
-                    break;
-                case 0xC: // ProgramChange(prog_num)
-                    midiin_ptr->onPatchChange(channel, b1);
-                    break;
-              //case 0xD: // ~ChannelPressure(aftertouch_pressure)
-                case 0xE: // PitchWheel(LSB+MSB)
-                    midiin_ptr->onPitchWheelChange(channel, (b12 * ratio16Bit));
-                    break;
-                default:
-                    throw std::runtime_error("Midi command "
-                        + std::to_string(cmd_n) + "not recognized");
-                }
-            }
+            ++unknown_messages;
+            return;
         }
+        b2 = b1;
+        b1 = status;
+        status = running_status;
+    }
+    running_status = status;
+    void (*handler)(MidiIn&, int, int, int) =
+        VOICE_MESSAGES[(status >> 4) - 0x8];
+    if (handler)
+    {
+        handler(*this, status & 0x0F, b1 & 0x7F, b2 & 0x7F);
     }
 }
 
@@ -109,23 +227,28 @@ void MidiIn::eventLoop(MidiIn* midiin_ptr)
   Midi Input device processing to poll for given device number's signal flow
 @param devno
   Midi device enumerated by the platform (portmidi gets list when run sans args)
+@param wait
+  How the event thread waits between polls finding no input: BACKOFF sleeps
+  (up to MAX_WAIT), SPIN polls again at once for the least latency
 */
-MidiIn::MidiIn(int devno)
+MidiIn::MidiIn(int devno, WaitStrategy wait)
     : process_events(false), thread_running(false),
-    input_stream(nullptr), event_thread(nullptr)
+    input_stream(nullptr), event_thread(nullptr), wait_strategy(wait),
+    max_latency(0), running_status(0), in_sysex(false), unknown_messages(0)
 {
     Pm_Initialize();
-    PmError value = Pm_OpenInput(&input_stream, devno, 0, 64, 0, 0);
+    PmError value = Pm_OpenInput(&input_stream, devno, 0, INPUT_BUFFER, 0, 0);
     if (value != pmNoError) {
         Pm_Terminate();
         throw std::runtime_error("failed to open MIDI input device");
     }
+    // Running before the thread starts, or it may see false & exit at once
+    thread_running = true;
     event_thread = new std::thread(eventLoop, this);
     if (!event_thread->joinable())
     {
         throw std::runtime_error("failed to open launch thread");
     }
-    thread_running = true;
 }
 
 /**
@@ -135,9 +258,7 @@ MidiIn::MidiIn(int devno)
 */
 MidiIn::~MidiIn(void)
 {
-    stop();
-    thread_running = false;
-    if (event_thread->joinable()) { event_thread->join(); }
+    close();
     delete event_thread;
     Pm_Close(input_stream);
     Pm_Terminate();
@@ -149,7 +270,28 @@ MidiIn::~MidiIn(void)
 */
 void MidiIn::start()
 {
-    process_events = true;
+    {
+        std::lock_guard<std::mutex> lock(wake_lock);
+        process_events = true;
+    }
+    wake.notify_one();
+}
+
+/**
+@brief
+  End the event thread, returning once any callback in progress is done, so
+  no callback runs after (derived classes call this ahead of destroying the
+  state their callbacks use; later calls do nothing)
+*/
+void MidiIn::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(wake_lock);
+        process_events = false;
+        thread_running = false;
+    }
+    wake.notify_one();
+    if (event_thread->joinable()) { event_thread->join(); }
 }
 
 /**
@@ -160,3 +302,26 @@ void MidiIn::stop()
 {
     process_events = false;
 }
+
+/**
+@brief
+  Get the longest time the event thread has gone between polls while started,
+  bounding how late any event is noticed
+@return
+  Worst case input latency so far, in seconds
+*/
+double MidiIn::maxLatency(void) const
+{
+    return max_latency;
+}
+
+/**
+@brief
+  Get the count of midi messages that couldn't be decoded & were dropped
+@return
+  Undefined system messages & data bytes without a status byte so far
+*/
+unsigned long MidiIn::unknownMessages(void) const
+{
+    return unknown_messages;
+}
@@ -8,15 +8,22 @@
 
 #include <string>
 #include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include <portmidi.h>
 
 
 class MidiIn {
   public:
+    // how the event thread waits for input while started (portmidi has no
+    // blocking read, so while stopped it always blocks until start())
+    enum WaitStrategy { BACKOFF, SPIN };
     static std::string getDeviceInfo(void);
-    MidiIn(int devno);
+    MidiIn(int devno, WaitStrategy wait = BACKOFF);
     void start();
     void stop();
+    void close();
     virtual ~MidiIn(void);
     virtual void onNoteOn(int channel, int note, int velocity) { }
     virtual void onNoteOff(int channel, int note) { }
@@ -25,12 +32,22 @@ class MidiIn {
     virtual void onModulationWheelChange(int channel, int value) { }
     virtual void onControlChange(int channel, int number, int value) { }
     virtual void onPatchChange(int channel, int value) { }
+    double maxLatency(void) const;
+    unsigned long unknownMessages(void) const;
   private:
     PmStream *input_stream;
     std::thread *event_thread;
-    bool process_events,
-         thread_running;
+    std::atomic<bool> process_events,
+                      thread_running;
+    WaitStrategy wait_strategy;
+    std::mutex wake_lock;
+    std::condition_variable wake;
+    std::atomic<double> max_latency;
+    int running_status;
+    bool in_sysex;
+    std::atomic<unsigned long> unknown_messages;
     static void eventLoop(MidiIn *midiin_ptr);
+    void dispatch(PmMessage message);
 };
 
 
@@ -0,0 +1,358 @@
+/**
+@file
+  RealtimeCheck.cpp
+@brief
+  Debug build (RT_SAFETY_CHECK) detection of blocking calls on audio paths
+@project
+  SP24CS245-A Assignment 9 (4/5/24)
+@author
+  Ari Surprise (a.surprise@digipen.edu | 0050207)
+*/
+
+#include "RealtimeCheck.h" // Class header file
+
+#ifdef RT_SAFETY_CHECK
+
+#include <atomic> // std::atomic violation count, shared by every thread
+#include <cstdio> // std::fprintf of reports to stderr
+#include <cstdlib> // std::malloc, std::free backing operator new & delete
+#include <new> // std::bad_alloc, std::nothrow_t of operator new overloads
+#if defined(__linux__) && defined(__GLIBC__)
+#include <dlfcn.h> // dlsym of the hooked library functions
+#include <execinfo.h> // backtrace, backtrace_symbols_fd of stack traces
+#include <pthread.h> // pthread_mutex_t of the lock hook
+#include <unistd.h> // ssize_t of the read & write hooks
+#define REALTIMECHECK_GLIBC
+#elif defined(_WIN32)
+#include <windows.h> // CaptureStackBackTrace of stack traces
+#endif
+
+/// Violations reported in full, beyond which they're only counted
+constexpr unsigned long REPORT_LIMIT = 32;
+/// Deepest stack frames shown per report
+constexpr int TRACE_FRAMES = 32;
+
+/// Violations found on all threads
+static std::atomic<unsigned long> found(0);
+/// Real-time scopes the thread is in
+static thread_local int depth = 0;
+/// Outermost real-time scope the thread is in
+static thread_local const char* scope = nullptr;
+/// Set while the thread is reporting or forwarding a checked call, which
+/// mustn't report again
+static thread_local bool busy = false;
+
+/**
+@brief
+  Print the calling thread's stack trace to stderr
+*/
+static void trace(void)
+{
+#if defined(REALTIMECHECK_GLIBC)
+  void* frames[TRACE_FRAMES];
+  int count = backtrace(frames, TRACE_FRAMES);
+  backtrace_symbols_fd(frames, count, 2);
+#elif defined(_WIN32)
+  void* frames[TRACE_FRAMES];
+  unsigned short count = CaptureStackBackTrace(1, TRACE_FRAMES, frames, 0);
+  for (unsigned short i = 0; i < count; ++i)
+  {
+    std::fprintf(stderr, "  %p\n", frames[i]);
+  }
+#endif
+}
+
+/// Loads the stack trace library ahead of any real-time scope, as the first
+/// backtrace call allocates
+static struct Preload {
+  Preload(void)
+  {
+#if defined(REALTIMECHECK_GLIBC)
+    void* frame;
+    backtrace(&frame, 1);
+#endif
+  }
+} preload;
+
+RealtimeCheck::RealtimeCheck(const char* name)
+{
+  if (!depth++)
+  {
+    scope = name;
+  }
+}
+
+RealtimeCheck::~RealtimeCheck(void)
+{
+  if (!--depth)
+  {
+    scope = nullptr;
+  }
+}
+
+void RealtimeCheck::check(const char* operation)
+{
+  if (!depth || busy)
+  {
+    return;
+  }
+  busy = true;
+  unsigned long number = ++found;
+  if (number <= REPORT_LIMIT)
+  {
+    std::fprintf(stderr, "realtime violation %lu: %s in %s\n",
+      number, operation, scope);
+    trace();
+    if (number == REPORT_LIMIT)
+    {
+      std::fprintf(stderr, "further realtime violations only counted\n");
+    }
+  }
+  busy = false;
+}
+
+unsigned long RealtimeCheck::violations(void)
+{
+  return found;
+}
+
+/**
+@brief
+  Allocate for operator new, reporting once even where malloc is hooked too
+@param size
+  - Bytes to allocate
+@param operation
+  - Name of the operator reported
+@return
+  - Allocated memory, or null where out of memory
+*/
+static void* allocate(std::size_t size, const char* operation)
+{
+  RealtimeCheck::check(operation);
+  bool was = busy;
+  busy = true;
+  void* memory = std::malloc(size ? size : 1);
+  busy = was;
+  return memory;
+}
+
+/**
+@brief
+  Free for operator delete, reporting once even where free is hooked too
+@param memory
+  - Memory to release, ignored where null
+@param operation
+  - Name of the operator reported
+*/
+static void release(void* memory, const char* operation)
+{
+  if (!memory)
+  {
+    return;
+  }
+  RealtimeCheck::check(operation);
+  bool was = busy;
+  busy = true;
+  std::free(memory);
+  busy = was;
+}
+
+void* operator new(std::size_t size)
+{
+  void* memory = allocate(size, "operator new");
+  if (!memory)
+  {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void* operator new[](std::size_t size)
+{
+  void* memory = allocate(size, "operator new[]");
+  if (!memory)
+  {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+  return allocate(size, "operator new");
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+  return allocate(size, "operator new[]");
+}
+
+void operator delete(void* memory) noexcept
+{
+  release(memory, "operator delete");
+}
+
+void operator delete[](void* memory) noexcept
+{
+  release(memory, "operator delete[]");
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+  release(memory, "operator delete");
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+  release(memory, "operator delete[]");
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept
+{
+  release(memory, "operator delete");
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept
+{
+  release(memory, "operator delete[]");
+}
+
+#if defined(REALTIMECHECK_GLIBC)
+
+extern "C" {
+
+// glibc's own allocator entry points, which the malloc hooks forward to
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* memory, size_t size);
+void __libc_free(void* memory);
+
+/**
+@brief
+  Look up the next definition of a hooked library function, past this one
+@param name
+  - Name of the function
+@return
+  - The library's function
+*/
+static void* next(const char* name)
+{
+  bool was = busy;
+  busy = true;
+  void* function = dlsym(RTLD_NEXT, name);
+  busy = was;
+  return function;
+}
+
+void* malloc(size_t size)
+{
+  RealtimeCheck::check("malloc");
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+  RealtimeCheck::check("calloc");
+  return __libc_calloc(count, size);
+}
+
+void* realloc(void* memory, size_t size)
+{
+  RealtimeCheck::check("realloc");
+  return __libc_realloc(memory, size);
+}
+
+void free(void* memory)
+{
+  if (memory)
+  {
+    RealtimeCheck::check("free");
+  }
+  __libc_free(memory);
+}
+
+int pthread_mutex_lock(pthread_mutex_t* mutex)
+{
+  // Looked up without a function local static, whose guard may itself lock
+  static int (*real)(pthread_mutex_t*) = nullptr;
+  if (!real)
+  {
+    real = (int (*)(pthread_mutex_t*))next("pthread_mutex_lock");
+  }
+  RealtimeCheck::check("pthread_mutex_lock");
+  return real(mutex);
+}
+
+FILE* fopen(const char* path, const char* mode)
+{
+  static FILE* (*real)(const char*, const char*) = nullptr;
+  if (!real)
+  {
+    real = (FILE* (*)(const char*, const char*))next("fopen");
+  }
+  RealtimeCheck::check("fopen");
+  return real(path, mode);
+}
+
+size_t fread(void* buffer, size_t size, size_t count, FILE* file)
+{
+  static size_t (*real)(void*, size_t, size_t, FILE*) = nullptr;
+  if (!real)
+  {
+    real = (size_t (*)(void*, size_t, size_t, FILE*))next("fread");
+  }
+  RealtimeCheck::check("fread");
+  return real(buffer, size, count, file);
+}
+
+size_t fwrite(const void* buffer, size_t size, size_t count, FILE* file)
+{
+  static size_t (*real)(const void*, size_t, size_t, FILE*) = nullptr;
+  if (!real)
+  {
+    real = (size_t (*)(const void*, size_t, size_t, FILE*))next("fwrite");
+  }
+  RealtimeCheck::check("fwrite");
+  return real(buffer, size, count, file);
+}
+
+ssize_t read(int fd, void* buffer, size_t size)
+{
+  static ssize_t (*real)(int, void*, size_t) = nullptr;
+  if (!real)
+  {
+    real = (ssize_t (*)(int, void*, size_t))next("read");
+  }
+  RealtimeCheck::check("read");
+  return real(fd, buffer, size);
+}
+
+ssize_t write(int fd, const void* buffer, size_t size)
+{
+  static ssize_t (*real)(int, const void*, size_t) = nullptr;
+  if (!real)
+  {
+    real = (ssize_t (*)(int, const void*, size_t))next("write");
+  }
+  RealtimeCheck::check("write");
+  return real(fd, buffer, size);
+}
+
+void __cxa_throw(void* thrown, void* type, void (*destroy)(void*))
+{
+  typedef void (*Throw)(void*, void*, void (*)(void*));
+  static Throw real = nullptr;
+  if (!real)
+  {
+    real = (Throw)next("__cxa_throw");
+  }
+  RealtimeCheck::check("throw");
+  real(thrown, type, destroy);
+  __builtin_unreachable();
+}
+
+}
+
+#endif
+
+#endif
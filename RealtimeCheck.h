@@ -0,0 +1,69 @@
+/**
+@file
+  RealtimeCheck.h
+@brief
+  Debug build (RT_SAFETY_CHECK) detection of blocking calls on audio paths
+@project
+  SP24CS245-A Assignment 9 (4/5/24)
+@author
+  Ari Surprise (a.surprise@digipen.edu | 0050207)
+*/
+
+#ifndef CS245_REALTIMECHECK_H
+#define CS245_REALTIMECHECK_H
+
+#ifdef RT_SAFETY_CHECK
+
+/// Marks the constructing thread as on a real-time path while in scope, so
+/// hooked allocation, locking, file I/O & throws report with a stack trace.
+/// The allocator is hooked on every platform; glibc builds (link with -ldl,
+/// and -rdynamic for symbol names) also hook malloc, pthread_mutex_lock,
+/// fopen/fread/fwrite, read/write & __cxa_throw
+class RealtimeCheck {
+  public:
+    /**
+    @brief
+      Enter a real-time scope on the calling thread (scopes may nest)
+    @param name
+      - Name of the real-time path reported with any violation
+    */
+    explicit RealtimeCheck(const char* name);
+
+    /**
+    @brief
+      Leave the real-time scope
+    */
+    ~RealtimeCheck(void);
+
+    /**
+    @brief
+      Report a potentially blocking operation if the calling thread is in a
+      real-time scope (called by the hooks)
+    @param operation
+      - Name of the operation about to be performed
+    */
+    static void check(const char* operation);
+
+    /**
+    @brief
+      Get the count of violations found, whether reported or not
+    @return
+      - Blocking operations performed within real-time scopes so far
+    */
+    static unsigned long violations(void);
+
+  private:
+    RealtimeCheck(const RealtimeCheck&) = delete;
+    RealtimeCheck& operator=(const RealtimeCheck&) = delete;
+};
+
+/// Check the rest of the enclosing block for blocking operations
+#define RT_SAFETY_SCOPE(name) RealtimeCheck realtime_check(name)
+
+#else
+
+#define RT_SAFETY_SCOPE(name)
+
+#endif
+
+#endif
@@ -0,0 +1,187 @@
+/**
+@file
+  RenderPool.cpp
+@brief
+  Pool of pinned worker threads splitting each rendered block between them
+@project
+  SP24CS245-A Assignment 9 (4/5/24)
+@author
+  Ari Surprise (a.surprise@digipen.edu | 0050207)
+*/
+
+#include "RenderPool.h" // Class header file
+#include "DenormalGuard.h" // FTZ/DAZ on every thread executing job parts
+#include "RealtimeCheck.h" // Debug build checks for blocking calls
+#include <chrono> // Bounding how long idle workers spin before blocking
+#include <climits> // INT_MAX threads woken
+#ifdef _WIN32
+#include <windows.h> // SetThreadAffinityMask, WaitOnAddress
+#pragma comment(lib, "Synchronization.lib") // WaitOnAddress, WakeByAddressAll
+#elif defined(__linux__)
+#include <pthread.h> // pthread_setaffinity_np
+#include <linux/futex.h> // FUTEX_WAIT_PRIVATE, FUTEX_WAKE_PRIVATE
+#include <sys/syscall.h> // SYS_futex
+#include <unistd.h> // syscall
+#endif
+
+/// Busy wait iterations before a waiting thread starts yielding its core
+constexpr unsigned SPIN_LIMIT = 4096;
+
+/// Time an idle worker spins & yields for before blocking until woken
+constexpr std::chrono::microseconds IDLE_SPIN(500);
+
+static_assert(sizeof(std::atomic<unsigned>) == sizeof(unsigned),
+  "generation must be a plain 32 bit word to wait on");
+
+/**
+@brief
+  Block the calling thread while a counter holds the given value (woken by
+  wake, or spuriously; polls briefly where the platform can't block on it)
+@param counter
+  - Counter to wait on
+@param seen
+  - Value to wait while the counter still holds
+*/
+static void block(std::atomic<unsigned>& counter, unsigned seen)
+{
+#ifdef _WIN32
+  WaitOnAddress((volatile VOID*)&counter, &seen, sizeof(seen), INFINITE);
+#elif defined(__linux__)
+  syscall(SYS_futex, (unsigned*)&counter, FUTEX_WAIT_PRIVATE, seen, nullptr,
+    nullptr, 0);
+#else
+  if (counter.load() == seen) { std::this_thread::sleep_for(IDLE_SPIN); }
+#endif
+}
+
+/**
+@brief
+  Wake every thread blocked on a counter (a system call, never a lock)
+@param counter
+  - Counter changed since the threads blocked
+*/
+static void wake(std::atomic<unsigned>& counter)
+{
+#ifdef _WIN32
+  WakeByAddressAll((PVOID)&counter);
+#elif defined(__linux__)
+  syscall(SYS_futex, (unsigned*)&counter, FUTEX_WAKE_PRIVATE, INT_MAX,
+    nullptr, nullptr, 0);
+#else
+  (void)counter;
+#endif
+}
+
+/**
+@brief
+  Pin a thread to run only on the given core (no-op where unsupported)
+@param thread
+  - Thread to pin
+@param core
+  - Index of the core to pin the thread to (wrapped to the available cores)
+*/
+static void pin(std::thread& thread, unsigned core)
+{
+  unsigned cores = std::thread::hardware_concurrency();
+  if (cores == 0) { return; }
+  core %= cores;
+#ifdef _WIN32
+  if (core < sizeof(DWORD_PTR) * 8)
+  {
+    SetThreadAffinityMask(thread.native_handle(), (DWORD_PTR)1 << core);
+  }
+#elif defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(core, &set);
+  pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+  (void)thread;
+#endif
+}
+
+RenderPool::RenderPool(unsigned threads)
+  : job(nullptr), generation(0), remaining(0), sleepers(0), running(true)
+{
+  unsigned i;
+  if (threads == 0) { threads = 1; }
+  workers.reserve(threads - 1);
+  for (i = 1; i < threads; ++i)
+  {
+    workers.push_back(std::thread(work, this, i, threads));
+    pin(workers.back(), i);
+  }
+}
+
+RenderPool::~RenderPool(void)
+{
+  running.store(false, std::memory_order_relaxed);
+  generation.fetch_add(1);
+  wake(generation);
+  for (std::thread& worker : workers)
+  {
+    worker.join();
+  }
+}
+
+unsigned RenderPool::threads(void) const
+{
+  return (unsigned)workers.size() + 1;
+}
+
+void RenderPool::run(Job& job_in)
+{
+  unsigned spins = 0, parts = threads();
+  // the calling (render) thread's part flushes denormals as workers' do
+  DenormalGuard guard;
+  if (parts == 1)
+  {
+    job_in.execute(0, 1);
+    return;
+  }
+  job = &job_in;
+  remaining.store(parts - 1, std::memory_order_relaxed);
+  // sequentially consistent, so either a worker about to block sees the new
+  // generation or its sleeper count is seen here and it is woken
+  generation.fetch_add(1);
+  if (sleepers.load() != 0) { wake(generation); }
+  job_in.execute(0, parts);
+  while (remaining.load(std::memory_order_acquire) != 0)
+  {
+    if (SPIN_LIMIT < ++spins) { std::this_thread::yield(); }
+  }
+}
+
+void RenderPool::work(RenderPool* pool, unsigned part, unsigned parts)
+{
+  typedef std::chrono::steady_clock clock;
+  unsigned seen = 0, now, spins;
+  clock::time_point idle;
+  DenormalGuard guard;
+  while (true)
+  {
+    // spin, then yield, for a bounded time before blocking until woken, so
+    // idle workers leave their cores between callbacks & while stopped
+    spins = 0;
+    idle = clock::now();
+    while ((now = pool->generation.load(std::memory_order_acquire)) == seen)
+    {
+      if (++spins < SPIN_LIMIT) { continue; }
+      if (clock::now() - idle < IDLE_SPIN)
+      {
+        std::this_thread::yield();
+        continue;
+      }
+      pool->sleepers.fetch_add(1);
+      block(pool->generation, seen);
+      pool->sleepers.fetch_sub(1);
+    }
+    seen = now;
+    if (!pool->running.load(std::memory_order_relaxed)) { return; }
+    {
+      RT_SAFETY_SCOPE("RenderPool worker");
+      pool->job->execute(part, parts);
+    }
+    pool->remaining.fetch_sub(1, std::memory_order_release);
+  }
+}
@@ -0,0 +1,108 @@
+/**
+@file
+  RenderPool.h
+@brief
+  Pool of pinned worker threads splitting each rendered block between them
+@project
+  SP24CS245-A Assignment 9 (4/5/24)
+@author
+  Ari Surprise (a.surprise@digipen.edu | 0050207)
+*/
+
+#ifndef CS245_RENDERPOOL_H
+#define CS245_RENDERPOOL_H
+
+#include <atomic> // Block generation & completion counts shared by threads
+#include <thread> // Worker threads
+#include <vector> // Worker thread storage sized on construction
+
+/// Threads waiting (spinning briefly, then blocked without locks) to each
+/// render a part of every job run
+class RenderPool {
+  public:
+
+    /// Work split into parts executed concurrently, one per pool thread
+    class Job {
+      public:
+        /**
+        @brief
+          Execute one part of the job (called once per part, concurrently)
+        @param part
+          - [0, parts) index of the part to execute; part 0 is the caller's
+        @param parts
+          - Count of parts the job is split into
+        */
+        virtual void execute(unsigned part, unsigned parts) = 0;
+
+      protected:
+        ~Job(void) {}
+    };
+
+    /**
+    @brief
+      Launch the worker threads, pinning each to its own core where possible
+    @param threads
+      - Count of threads executing each job, including the thread calling run
+    */
+    explicit RenderPool(unsigned threads = 1);
+
+    /**
+    @brief
+      Stop and join the worker threads
+    */
+    ~RenderPool(void);
+
+    /**
+    @brief
+      Get the count of parts each job is split into
+    @return
+      - Worker threads + 1 for the thread calling run
+    */
+    unsigned threads(void) const;
+
+    /**
+    @brief
+      Execute every part of a job, returning once all parts are complete
+      (no allocation or locking; the calling thread executes part 0, and
+      every part runs with denormals flushed to zero)
+    @param job
+      - Job to split between the calling thread and the worker threads
+    */
+    void run(Job& job);
+
+  private:
+    RenderPool(const RenderPool&) = delete;
+    RenderPool& operator=(const RenderPool&) = delete;
+
+    /**
+    @brief
+      Worker thread loop, waiting for each new job to execute its part
+    @param pool
+      - Pool the worker belongs to
+    @param part
+      - [1, parts) part of each job the worker executes
+    @param parts
+      - Count of parts each job is split into
+    */
+    static void work(RenderPool* pool, unsigned part, unsigned parts);
+
+    /// Worker threads, executing parts [1, threads) of each job
+    std::vector<std::thread> workers;
+
+    /// Job being executed for the current generation
+    Job* job;
+
+    /// Count of jobs run; a change signals workers to execute the new job
+    alignas(64) std::atomic<unsigned> generation;
+
+    /// Count of worker parts of the current job not yet complete
+    alignas(64) std::atomic<unsigned> remaining;
+
+    /// Count of workers blocked (or about to block) waiting for a job
+    std::atomic<unsigned> sleepers;
+
+    /// Cleared to have workers exit
+    std::atomic<bool> running;
+};
+
+#endif
@@ -94,8 +94,21 @@ void Resample::next(void)
 */
 void Resample::pitchOffset(float cents)
 {
-	float pitch = (float)pow(2.0, cents * OCTAVE_CENTILES);
-	speedup = multiplier * pitch;
+	speedup = multiplier * pitchRatio(cents);
+}
+
+
+/**
+@brief
+	Get the sampling increment gain factor sounding a pitch offset
+@param cents
+	- -1.0 => -0.01 semitone by which to pitch shift down from base
+@return
+	Factor by which a base sampling increment is scaled for the pitch shift
+*/
+float Resample::pitchRatio(float cents)
+{
+	return (float)pow(2.0, cents * OCTAVE_CENTILES);
 }
 
 
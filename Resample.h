@@ -16,6 +16,7 @@ class Resample {
     void next(void);
     void pitchOffset(float cents);
     void reset(void);
+    static float pitchRatio(float cents);
   private:
     const AudioData *audio_data;
     unsigned ichannel;
@@ -0,0 +1,79 @@
+/**
+@file
+  SynthInput.cpp
+@brief
+  Midi input device forwarding its events to the synths it plays
+@project
+  SP24CS245-A Assignment 9 (4/5/24)
+@author
+  Ari Surprise (a.surprise@digipen.edu | 0050207)
+*/
+
+#include "SynthInput.h" // Class header file
+
+SynthInput::SynthInput(int devno, const std::vector<WavetableSynth*>& synths)
+  : MidiIn(devno), targets(synths)
+{
+  start();
+}
+
+SynthInput::~SynthInput(void)
+{
+  close();
+}
+
+void SynthInput::onModulationWheelChange(int channel, int value)
+{
+  for (WavetableSynth* synth : targets)
+  {
+    synth->onModulationWheelChange(channel, value);
+  }
+}
+
+void SynthInput::onNoteOff(int channel, int note)
+{
+  for (WavetableSynth* synth : targets)
+  {
+    synth->onNoteOff(channel, note);
+  }
+}
+
+void SynthInput::onNoteOn(int channel, int note, int velocity)
+{
+  for (WavetableSynth* synth : targets)
+  {
+    synth->onNoteOn(channel, note, velocity);
+  }
+}
+
+void SynthInput::onPatchChange(int channel, int value)
+{
+  for (WavetableSynth* synth : targets)
+  {
+    synth->onPatchChange(channel, value);
+  }
+}
+
+void SynthInput::onPitchWheelChange(int channel, float value)
+{
+  for (WavetableSynth* synth : targets)
+  {
+    synth->onPitchWheelChange(channel, value);
+  }
+}
+
+void SynthInput::onVolumeChange(int channel, int level)
+{
+  for (WavetableSynth* synth : targets)
+  {
+    synth->onVolumeChange(channel, level);
+  }
+}
+
+void SynthInput::onControlChange(int channel, int number, int value)
+{
+  for (WavetableSynth* synth : targets)
+  {
+    synth->onControlChange(channel, number, value);
+  }
+}
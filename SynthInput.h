@@ -0,0 +1,60 @@
+/**
+@file
+  SynthInput.h
+@brief
+  Midi input device forwarding its events to the synths it plays
+@project
+  SP24CS245-A Assignment 9 (4/5/24)
+@author
+  Ari Surprise (a.surprise@digipen.edu | 0050207)
+*/
+
+#ifndef CS245_SYNTHINPUT_H
+#define CS245_SYNTHINPUT_H
+
+#include "MidiIn.h" // Base class polling the midi device
+#include "WavetableSynth.h" // Synths events are forwarded to
+#include <vector> // Synths played, fixed on construction
+
+/// Owner of a midi input device, playing one synth or several layered
+class SynthInput : private MidiIn {
+  public:
+    /**
+    @brief
+      Open a midi input device and start forwarding its events
+    @param devno
+      - System enumeration of available midi input devices to read from
+    @param synths
+      - Synths every event is forwarded to (each fed by this input only)
+    @throw std::runtime_error
+      - Where the device fails to open
+    */
+    SynthInput(int devno, const std::vector<WavetableSynth*>& synths);
+
+    /**
+    @brief
+      Stop forwarding events, joining the event thread so no callback still
+      reads the targets as they are destroyed
+    */
+    ~SynthInput(void);
+
+    /// Worst case seconds between the device's polls, bounding input latency
+    using MidiIn::maxLatency;
+
+    /// Midi messages dropped as undecodable
+    using MidiIn::unknownMessages;
+
+  private:
+    void onModulationWheelChange(int channel, int value) override;
+    void onNoteOff(int channel, int note) override;
+    void onNoteOn(int channel, int note, int velocity) override;
+    void onPatchChange(int channel, int value) override;
+    void onPitchWheelChange(int channel, float value) override;
+    void onVolumeChange(int channel, int level) override;
+    void onControlChange(int channel, int number, int value) override;
+
+    /// Synths every event is forwarded to
+    std::vector<WavetableSynth*> targets;
+};
+
+#endif
@@ -11,17 +11,34 @@
 
 #define _USE_MATH_DEFINES
 #include <cmath> // Math constant definitions, trig functions, etc
+#include <algorithm> // std::fill, std::min for block rendering
+#include <chrono> // Arrival timestamps of events for sample accurate playback
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP)
+#include <xmmintrin.h> // SSE mixing of mono note output into stereo
+#define WAVETABLESYNTH_SSE
+#endif
 #include "WavetableSynth.h" // Class header file
+#include "Resample.h" // Pitch ratios of key, bend & vibrato offsets
+#include "RealtimeCheck.h" // Debug build checks for blocking calls
 
 /// Epsilon infinitesimal for narrow float ranges
 constexpr float EPSILON = 0.01f;
 
+/// Level release tails are cut off at while rendering is short of time
+constexpr float TAIL_CULL = 0.05f;
+
 /// Cents up from middle C note to the A above it, ie A sounding 440 Hz
 constexpr float A440_CENTS = 6900.0f;
 
 /// Cents up from middle C note to the A above it, ie A sounding 440 Hz
 constexpr float MIX_DOWN = 0.3f;
 
+/// Mask of a midi channel number, keeping queued events within tables
+constexpr int CHANNEL_MASK = 0x0F;
+
+/// Mask of a 7 bit midi data value (key, velocity, program or controller)
+constexpr int DATA_MASK = 0x7F;
+
 /// Scalar of 100 cents per semitone
 constexpr int CENTS_SCALE = 100;
 
@@ -31,234 +48,711 @@ constexpr float CENTS_RANGE = 2.0f * CENTS_SCALE;
 /// Precomputed (1/127) for more efficient division of a common divisor
 constexpr float RATIO_7BIT = 1.0f / 127.0f;
 
-/// 2*pi; tau; circle diameter constant; revolutions -> radians
-constexpr float TWO_PI = (float)(2.0 * M_PI);
+/// Mod wheel vibrato rate, sounding a 5 Hz modulation cycle
+constexpr float VIBRATO_HZ = 5.0f;
+
+/// Pan position [-1,1] of the lowest & highest keys, tracked linearly between
+constexpr float KEY_PAN_SPREAD = 0.6f;
+
+/// Midi key centered in the stereo field
+constexpr int CENTER_KEY = 64;
+
+/// Loudness buckets (6 dB apart) per held / released class of notes to steal
+constexpr int LOUDNESS_BUCKETS = 16;
+
+/// Midi controller number of channel pan position
+constexpr int PAN_CONTROL = 10;
+
+/// pi/4; quarter circle; pan position [-1,1] + 1 -> constant power angle
+constexpr float QUARTER_PI = (float)(M_PI / 4.0);
+
+/**
+@brief
+  Get the current time of a monotonic clock shared by midi & render threads
+@return
+  - Seconds since an arbitrary (fixed) epoch of the steady clock
+*/
+static double seconds(void)
+{
+  return std::chrono::duration<double>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+@brief
+  Get the stealing bucket of a note, ordered to steal released notes before
+  held ones, and quieter before louder within each
+@param loudness
+  - [0,1] envelope level scaled by velocity of the note
+@param released
+  - Whether the note is releasing (no longer held)
+@return
+  - [0, 2 * LOUDNESS_BUCKETS) bucket; lower buckets are stolen first
+*/
+static int stealBucket(float loudness, bool released)
+{
+  // ilogb is the power of 2 (6 dB step) below the loudness, <= 0 in (0,1]
+  int quieter = (loudness <= 0) ? LOUDNESS_BUCKETS - 1 :
+    std::min(std::max(-std::ilogb(loudness), 0), LOUDNESS_BUCKETS - 1);
+  return (released ? 0 : LOUDNESS_BUCKETS) + LOUDNESS_BUCKETS - 1 - quieter;
+}
+
+WavetableSynth::WavetableSynth(std::shared_ptr<const Keymap> bank, int R,
+  int polyphony, int threads)
+  : keymap(bank), tail_active(polyphony), tail_position(polyphony),
+  tailing(0), governor((float)R), quality(CpuGovernor::FULL),
+  env(0.01f, 600.0f, 0.8f, 4.0f, (float)R),
+  active(polyphony + STEAL_RESERVE), position(polyphony + STEAL_RESERVE),
+  capacity(polyphony + STEAL_RESERVE), limit(polyphony),
+  next_stealable(polyphony + STEAL_RESERVE),
+  struck(MAX_EVENTS), struck_count(0), struck_next(0),
+  fading(0), faded(polyphony + STEAL_RESERVE), fade_first(0),
+  bucketed(polyphony + STEAL_RESERVE, false),
+  rendered_at(seconds()), sounding(0), rate((float)R),
+  lfo(VIBRATO_HZ, (float)R), segment_count(0), run_frames(0), pool(threads),
+  mixes(pool.threads() * MAX_SEGMENTS * BLOCK_FRAMES * OUTPUT_CHANNELS)
+{
+  int i;
+  const Channel initial = { 0, 0.5f, 0, 0, 0, 0, false, false,
+    false };
+  std::fill(channels, channels + MIDI_CHANNELS, initial);
+  playing.resize(capacity);
+  tails.resize(polyphony);
+  std::fill(&keyed[0][0], &keyed[0][0] + MIDI_CHANNELS * MIDI_KEYS, -1);
+  std::fill(&robin[0][0], &robin[0][0] + MIDI_CHANNELS * MIDI_KEYS, 0u);
+  std::fill(stealable, stealable + STEAL_BUCKETS, -1);
+  for (i = 0; i < capacity; ++i)
+  {
+    active[i] = position[i] = i;
+    playing.key[i] = -1;
+    playing.vel[i] = 0;
+  }
+  for (i = 0; i < polyphony; ++i)
+  {
+    tail_active[i] = tail_position[i] = i;
+    tails.key[i] = -1;
+    tails.vel[i] = 0;
+  }
+}
+
+void WavetableSynth::render(float* out, unsigned long frames)
+{
+  unsigned long done, n, j, at;
+  unsigned part;
+  int i, note, bucket;
+  double now = seconds();
+  const Event* next;
+  Event event;
+  RT_SAFETY_SCOPE("WavetableSynth::render");
+  quality = governor.level();
+  std::fill(out, out + frames * OUTPUT_CHANNELS, 0.0f);
+  for (done = 0; done < frames; done += n)
+  {
+    n = std::min<unsigned long>(frames - done, MAX_SEGMENTS * BLOCK_FRAMES);
+    // apply events due by this sample, stopping short at the next one due
+    while ((next = events.front()) && next->time < now)
+    {
+      at = offset(*next, frames);
+      if (done < at)
+      {
+        n = std::min(n, at - done);
+        break;
+      }
+      events.pop(event);
+      dispatch(event);
+    }
+    // one pool run renders every segment up to the next event
+    plan((unsigned)n);
+    pool.run(*this);
+    // sum part mixes in a fixed order so output is the same on every run
+    for (part = 0; part < pool.threads(); ++part)
+    {
+      for (j = 0; j < n * OUTPUT_CHANNELS; ++j)
+      {
+        out[done * OUTPUT_CHANNELS + j] +=
+          mixes[part * MAX_SEGMENTS * BLOCK_FRAMES * OUTPUT_CHANNELS + j];
+      }
+    }
+    // back to front so finished notes swap out only already checked notes,
+    // bucketing the rest by loudness for note on to steal the quietest
+    std::fill(stealable, stealable + STEAL_BUCKETS, -1);
+    struck_count = struck_next = 0;
+    // drop finished notes from the fading list, keeping the oldest first
+    for (i = j = 0; i < fading; ++i)
+    {
+      note = faded[(fade_first + i) % capacity];
+      if (0 <= playing.key[note])
+      {
+        faded[(fade_first + j++) % capacity] = note;
+      }
+    }
+    fading = (int)j;
+    for (i = sounding - 1; 0 <= i; --i)
+    {
+      note = active[i];
+      if (playing.key[note] < 0)
+      {
+        deactivate(active, position, sounding, note);
+        continue;
+      }
+      if (playing.mode[note] == ADSR::FADE) { continue; }
+      bucket = stealBucket(playing.level[note] * playing.vel[note],
+        playing.mode[note] == ADSR::RELEASE);
+      next_stealable[note] = stealable[bucket];
+      stealable[bucket] = note;
+      bucketed[note] = true;
+    }
+    // at the lowest quality level shed the quietest notes down to half the
+    // limit, cutting the voices rendered rather than only new notes
+    while (CpuGovernor::FEWER_NOTES <= quality
+      && limit / 2 < sounding - fading && 0 <= steal()) {}
+    for (i = tailing - 1; 0 <= i; --i)
+    {
+      note = tail_active[i];
+      if (tails.key[note] < 0)
+      {
+        deactivate(tail_active, tail_position, tailing, note);
+      }
+    }
+  }
+  rendered_at = now;
+  governor.measure(seconds() - now, frames);
+}
 
-/// Mod wheel sin period scale: 5Hz*2pi, sounding a 5 Hz modulation cycle
-constexpr float REV_TO_HZ = 5.0f * TWO_PI;
+int WavetableSynth::activeNotes(void) const
+{
+  return sounding + tailing;
+}
 
-/// Baby Upright Acoustic Grand Piano's A0 keypress recording
-WavetableSynth::WaveData grand0("UpGrand_A22_5.wav", 16.0f, 46310, 66775);
+int WavetableSynth::qualityLevel(void) const
+{
+  return governor.level();
+}
 
-/// Baby Upright Acoustic Grand Piano's A1 keypress recording
-WavetableSynth::WaveData grand1("UpGrand_A55.wav", 8.0f, 129883, 197134);
+unsigned long WavetableSynth::overruns(void) const
+{
+  return governor.overruns();
+}
 
-/// Baby Upright Acoustic Grand Piano's A2 keypress recording
-WavetableSynth::WaveData grand2("UpGrand_A110.wav", 4.0f, 71353, 117383);
+void WavetableSynth::onModulationWheelChange(int channel, int value)
+{
+  Event event = { Event::ModulationWheel, (short)(channel & CHANNEL_MASK),
+    (short)(value & DATA_MASK), 0, 0, seconds() };
+  events.push(event);
+}
 
-/// Baby Upright Acoustic Grand Piano's A3 keypress recording
-WavetableSynth::WaveData grand3("UpGrand_A220.wav", 2.0f, 109664, 169738);
+void WavetableSynth::onNoteOff(int channel, int note)
+{
+  Event event = { Event::NoteOff, (short)(channel & CHANNEL_MASK),
+    (short)(note & DATA_MASK), 0, 0, seconds() };
+  events.push(event);
+}
 
-/// Baby Upright Acoustic Grand Piano's A4 keypress recording
-WavetableSynth::WaveData grand4("UpGrand_A440.wav", 1.0f, 56129, 100326);
+void WavetableSynth::onNoteOn(int channel, int note, int velocity)
+{
+  Event event = { Event::NoteOn, (short)(channel & CHANNEL_MASK),
+    (short)(note & DATA_MASK), (short)(velocity & DATA_MASK), 0, seconds() };
+  events.push(event);
+}
 
-/// Baby Upright Acoustic Grand Piano's A5 keypress recording
-WavetableSynth::WaveData grand5("UpGrand_A880.wav", 0.5f, 11437, 40303);
+void WavetableSynth::onPatchChange(int channel, int value)
+{
+  Event event = { Event::PatchChange, (short)(channel & CHANNEL_MASK),
+    (short)(value & DATA_MASK), 0, 0, seconds() };
+  events.push(event);
+}
 
-/// Baby Upright Acoustic Grand Piano's A6 keypress recording
-WavetableSynth::WaveData grand6("UpGrand_A1760.wav", 0.25f, 6344, 13215);
+void WavetableSynth::onPitchWheelChange(int channel, float value)
+{
+  Event event = { Event::PitchWheel, (short)(channel & CHANNEL_MASK), 0, 0,
+    value, seconds() };
+  events.push(event);
+}
 
-/// Baby Upright Acoustic Grand Piano's A7 keypress recording
-WavetableSynth::WaveData grand7("UpGrand_A3520.wav", 0.125f, 14565, 28123);
+void WavetableSynth::onVolumeChange(int channel, int level)
+{
+  Event event = { Event::Volume, (short)(channel & CHANNEL_MASK),
+    (short)(level & DATA_MASK), 0, 0, seconds() };
+  events.push(event);
+}
 
-/// Cello sample from CS245 class materials
-WavetableSynth::WaveData cello("Cello.wav",
-  4.51280512805128051280512805128051281f, 39763, 42019);
+void WavetableSynth::onControlChange(int channel, int number, int value)
+{
+  if (number != PAN_CONTROL) { return; }
+  Event event = { Event::Pan, (short)(channel & CHANNEL_MASK),
+    (short)(value & DATA_MASK), 0, 0, seconds() };
+  events.push(event);
+}
 
-/// Oboe sample from CS245 class materials
-WavetableSynth::WaveData oboe("Oboe.wav",
-  0.990990990990990990990990990990990990991f, 322, 17455);
+unsigned long WavetableSynth::offset(const Event& event,
+  unsigned long frames) const
+{
+  double at = (event.time - rendered_at) * rate;
+  if (at <= 0) { return 0; }
+  return (at < frames) ? (unsigned long)at : frames - 1;
+}
 
-WavetableSynth::WavetableSynth(int devno, int R)
-  : MidiIn(devno), newest(0), patch(Default), bend(0), vibrato(0), vol(0.5f),
-  mod(0), mphase(0), rate((float)R)
+void WavetableSynth::dispatch(const Event& event)
 {
-  int i;
-  dphase = REV_TO_HZ / R;
-  for (i = 0; i < MAX_NOTES; ++i)
+  switch (event.type)
   {
-    playing[i] = Note(-1, 0, Voice::Default, (float)R);
+  case Event::NoteOn:
+    noteOn(event.channel, event.data1, event.data2); return;
+  case Event::NoteOff:
+    noteOff(event.channel, event.data1); return;
+  case Event::PatchChange:
+    patchChange(event.channel, event.data1); return;
+  case Event::PitchWheel:
+    pitchWheelChange(event.channel, event.value); return;
+  case Event::Volume:
+    volumeChange(event.channel, event.data1); return;
+  case Event::ModulationWheel:
+    modulationWheelChange(event.channel, event.data1); return;
+  case Event::Pan:
+    panChange(event.channel, event.data1); return;
+  default: return;
   }
-  start();
 }
 
-WavetableSynth::~WavetableSynth(void)
+void WavetableSynth::modulationWheelChange(int channel, int value)
 {
-  stop();
+  channels[channel].vibrato = value * CENTS_RANGE * RATIO_7BIT;
+  channels[channel].retune = true;
 }
 
-float WavetableSynth::output(void)
+void WavetableSynth::noteOff(int channel, int note)
 {
-  float output = 0.0f;
-  int i;
-  for (i = 0; i < MAX_NOTES; ++i)
+  int index = keyed[channel][note];
+  if (0 <= index)
   {
-    output += (playing[i].key < 0) ? 0.0f : playing[i].output();
+    playing.mode[index] = ADSR::RELEASE;
+    keyed[channel][note] = -1;
+    migrate(index);
   }
-  return output * vol;
 }
 
-void WavetableSynth::next(void)
+void WavetableSynth::noteOn(int channel, int note, int velocity)
 {
-  int i;
-  double t;
-  if (0 != vibrato)
+  int index = keyed[channel][note];
+  const Keymap::Zone* zone = keymap->find(channels[channel].patch, note,
+    velocity, robin[channel][note]++);
+  if (!zone) { return; }
+  // retrigger a held note (a released note's tail rings on separately)
+  if (0 <= index)
   {
-    t = mphase + dphase;
-    mphase = (t <= TWO_PI) ? t : (t - TWO_PI);
-    mod = vibrato * (float)sin(mphase);
-    for (i = 0; i < MAX_NOTES; ++i)
-    {
-      playing[i].phase.pitchOffset(mod + bend + playing[i].key - A440_CENTS);
-    }
+    playing.vel[index] = velocity * RATIO_7BIT;
+    setSound(index, *zone);
+    setGains(playing, index);
+    return;
+  }
+  // Past the limit fade out the quietest note, the new note taking a spare
+  // slot while it fades; with every spare taken, cut off the note fading
+  // longest instead (notes only fade once stolen, so one always is)
+  if (((CpuGovernor::FEWER_NOTES <= quality) ? limit / 2 : limit)
+    <= sounding - fading)
+  {
+    steal();
+  }
+  if (sounding < capacity)
+  {
+    index = active[sounding];
+    activate(active, position, sounding, index);
   }
-  for (i = 0; i < MAX_NOTES; ++i)
+  else
   {
-    playing[i].next();
+    if (fading == 0) { return; }
+    index = faded[fade_first];
+    fade_first = (fade_first + 1) % capacity;
+    --fading;
   }
+  // a reused slot's stale stealing bucket entry no longer stands for it
+  bucketed[index] = false;
+  if (struck_count < (int)struck.size()) { struck[struck_count++] = index; }
+  keyed[channel][note] = index;
+  playing.key[index] = note * CENTS_SCALE;
+  playing.vel[index] = velocity * RATIO_7BIT;
+  playing.part[index] = channel;
+  setSound(index, *zone);
+  setGains(playing, index);
 }
 
-void WavetableSynth::onModulationWheelChange(int channel, int value)
+void WavetableSynth::patchChange(int channel, int value)
 {
-  vibrato = value * CENTS_RANGE * RATIO_7BIT;
+  channels[channel].patch = value;
 }
 
-void WavetableSynth::onNoteOff(int channel, int note)
+void WavetableSynth::pitchWheelChange(int channel, float value)
 {
-  int i;
-  note *= CENTS_SCALE;
-  for (i = 0; i < MAX_NOTES; ++i)
+  channels[channel].bend = value * CENTS_RANGE; // Reused with vibrato on
+  channels[channel].retune = true;
+}
+
+void WavetableSynth::volumeChange(int channel, int level)
+{
+  channels[channel].vol = level * RATIO_7BIT;
+  channels[channel].regain = true;
+}
+
+void WavetableSynth::panChange(int channel, int value)
+{
+  channels[channel].pan = (value - CENTER_KEY) / (float)CENTER_KEY;
+  channels[channel].regain = true;
+}
+
+void WavetableSynth::Notes::copy(int note, const Notes& from, int other)
+{
+  phase[note] = from.phase[other];
+  increment[note] = from.increment[other];
+  ramp[note] = from.ramp[other];
+  level[note] = from.level[other];
+  left[note] = from.left[other];
+  right[note] = from.right[other];
+  source[note] = from.source[other];
+  loop_bgn[note] = from.loop_bgn[other];
+  loop_end[note] = from.loop_end[other];
+  channel[note] = from.channel[other];
+  mode[note] = from.mode[other];
+  speed[note] = from.speed[other];
+  key[note] = from.key[other];
+  vel[note] = from.vel[other];
+  part[note] = from.part[other];
+}
+
+void WavetableSynth::Notes::resize(int count)
+{
+  phase.resize(count);
+  increment.resize(count);
+  ramp.resize(count);
+  level.resize(count);
+  left.resize(count);
+  right.resize(count);
+  source.resize(count);
+  loop_bgn.resize(count);
+  loop_end.resize(count);
+  channel.resize(count);
+  mode.resize(count);
+  speed.resize(count);
+  key.resize(count);
+  vel.resize(count);
+  part.resize(count);
+}
+
+void WavetableSynth::renderNote(int note, const Segment& segment, float* mix)
+{
+  float level = playing.level[note];
+  ADSR::Mode mode = playing.mode[note];
+  env.advance(level, mode, segment.span);
+  mixNote(playing, note, level, quality < CpuGovernor::NEAREST,
+    mix + segment.start * OUTPUT_CHANNELS, segment.frames);
+  playing.mode[note] = mode;
+  if (ADSR::RELEASE <= mode && level < EPSILON)
   {
-    if (playing[i].key == note)
-    {
-      playing[i].env.sustainOff();
-    }
+    playing.key[note] = -1;
+    playing.vel[note] = 0;
   }
 }
 
-void WavetableSynth::onNoteOn(int channel, int note, int velocity)
+void WavetableSynth::renderTail(int note, const Segment& segment, float* mix)
 {
-  int i;
-  int index = -1;
-  note *= CENTS_SCALE;
-  // check exhaustively for note playing to early out
-  for (i = newest; i < MAX_NOTES; ++i)
+  float level = tails.level[note] * segment.span.release;
+  mixNote(tails, note, level, false, mix + segment.start * OUTPUT_CHANNELS,
+    segment.frames);
+  if (level < ((CpuGovernor::CULL_TAILS <= quality) ? TAIL_CULL : EPSILON))
   {
-    if (playing[i].key == note)
-    {
-      playing[i].vel = velocity * RATIO_7BIT;
-      playing[i].env.reset();
-      playing[i].phase.reset();
-      return;
-    }
-    // look for first free note slot concurrently
-    if (0 <= index && playing[i].key < 0) { index = i; }
+    tails.key[note] = -1;
+    tails.vel[note] = 0;
   }
-  for (i = 0; i < newest; ++i)
+}
+
+/// Per segment inputs & state of one note's resampling pass
+struct Voice
+{
+  const float* data; /// Source samples, offset to the channel read
+  unsigned stride, frames, loop_bgn, loop_end; /// Source layout & loop
+  double phase; /// Fractional source frame index
+  float increment, ramp, level, step; /// Pitch & level ramps
+};
+
+/**
+@brief
+  Resample a voice into mono samples, ramping its pitch & level, holding
+  every per sample term in locals
+@tparam LERP
+  - Whether to interpolate samples linearly rather than read the nearest
+@param voice
+  - Inputs & state of the voice, phase & increment advanced in place
+@param out
+  - Buffer of at least frames samples to be overwritten
+@param frames
+  - Count of samples to render
+@return
+  - Count of samples rendered (fewer once unlooped data runs out)
+*/
+template <bool LERP>
+static unsigned resampleVoice(Voice& voice, float* out, unsigned frames)
+{
+  const float* data = voice.data;
+  const unsigned stride = voice.stride, last = voice.frames - LERP;
+  const bool looped = voice.loop_bgn < voice.loop_end;
+  const double loop_end = voice.loop_end,
+    loop_length = (double)voice.loop_end - voice.loop_bgn;
+  double phase = voice.phase;
+  const float ramp = voice.ramp, step = voice.step;
+  float increment = voice.increment, level = voice.level, sample;
+  unsigned i, j;
+  for (i = 0; i < frames; ++i)
   {
-    if (playing[i].key == note)
+    while (looped && loop_end < phase) { phase -= loop_length; }
+    j = (unsigned)(LERP ? phase : phase + 0.5);
+    if (last <= j) { break; }
+    sample = data[j * stride];
+    if (LERP)
     {
-      playing[i].vel = velocity * RATIO_7BIT;
-      playing[i].env.reset();
-      playing[i].phase.reset();
-      return;
+      sample += (data[(j + 1) * stride] - sample) * (float)(phase - j);
     }
-    if (0 <= index && playing[i].key < 0) { index = i; }
+    out[i] = sample * level;
+    phase += increment;
+    increment += ramp;
+    level += step;
   }
-  // Look for note to steal if none were open
-  if (index < 0)
+  voice.phase = phase;
+  voice.increment = increment;
+  return i;
+}
+
+/**
+@brief
+  Accumulate mono samples into an interleaved stereo mix at fixed pan gains,
+  both channels in one pass (4 frames per SSE step where available)
+@param in
+  - Mono samples to be panned
+@param mix
+  - Interleaved stereo buffer of at least frames * 2 samples to add into
+@param frames
+  - Count of mono samples to mix
+@param left
+  - Gain of the left channel
+@param right
+  - Gain of the right channel
+*/
+static void mixStereo(const float* in, float* mix, unsigned frames,
+  float left, float right)
+{
+  unsigned i = 0;
+#ifdef WAVETABLESYNTH_SSE
+  __m128 gains = _mm_setr_ps(left, right, left, right), samples;
+  for (; i + 4 <= frames; i += 4)
+  {
+    samples = _mm_loadu_ps(in + i);
+    _mm_storeu_ps(mix + 2 * i, _mm_add_ps(_mm_loadu_ps(mix + 2 * i),
+      _mm_mul_ps(_mm_unpacklo_ps(samples, samples), gains)));
+    _mm_storeu_ps(mix + 2 * i + 4, _mm_add_ps(_mm_loadu_ps(mix + 2 * i + 4),
+      _mm_mul_ps(_mm_unpackhi_ps(samples, samples), gains)));
+  }
+#endif
+  for (; i < frames; ++i)
   {
-    index = (newest + 1 == MAX_NOTES) ? 0 : newest + 1;
+    mix[2 * i] += in[i] * left;
+    mix[2 * i + 1] += in[i] * right;
   }
-  playing[index].key = note;
-  playing[index].vel = velocity * RATIO_7BIT;
-  playing[i].inst = patch;
-  playing[index].Play(rate);
-  playing[index].env.reset();
-  newest = index;
 }
 
-void WavetableSynth::onPatchChange(int channel, int value)
+void WavetableSynth::mixNote(Notes& notes, int note, float target, bool lerp,
+  float* mix, unsigned frames)
 {
-  int i;
-  patch = (Voice)(value % Voice::Max);
-  for (i = 0; i < MAX_NOTES; ++i)
+  const AudioData* source = notes.source[note];
+  float level = notes.level[note], mono[BLOCK_FRAMES];
+  unsigned rendered;
+  Voice voice = { source->data() + notes.channel[note], source->channels(),
+    source->frames(), notes.loop_bgn[note], notes.loop_end[note],
+    notes.phase[note], notes.increment[note], notes.ramp[note], level,
+    (target - level) / frames };
+  rendered = lerp ? resampleVoice<true>(voice, mono, frames) :
+    resampleVoice<false>(voice, mono, frames);
+  mixStereo(mono, mix, rendered, notes.left[note], notes.right[note]);
+  notes.phase[note] = voice.phase;
+  notes.increment[note] = voice.increment;
+  notes.level[note] = target;
+}
+
+void WavetableSynth::plan(unsigned frames)
+{
+  int c;
+  unsigned start;
+  float vibrato;
+  for (segment_count = 0, start = 0; start < frames; start += BLOCK_FRAMES)
   {
-    playing[i] = Note(-1, 0, patch, rate);
+    Segment& segment = segments[segment_count++];
+    segment.start = start;
+    segment.frames = std::min<unsigned>(frames - start, BLOCK_FRAMES);
+    segment.span = env.span(segment.frames);
+    segment.update = false;
+    vibrato = lfo.next(segment.frames);
+    for (c = 0; c < MIDI_CHANNELS; ++c)
+    {
+      Channel& part = channels[c];
+      part.mod = part.vibrato * vibrato;
+      segment.mod[c] = part.mod;
+      segment.modulating[c] = (0 != part.vibrato) || part.retune;
+      segment.ramping[c] = part.ramping;
+      segment.regain[c] = part.regain;
+      segment.update = segment.update || segment.modulating[c]
+        || part.ramping || part.regain;
+      part.ramping = segment.modulating[c];
+      part.retune = part.regain = false;
+    }
   }
+  run_frames = frames;
 }
 
-void WavetableSynth::onPitchWheelChange(int channel, float value)
+void WavetableSynth::modulateNote(Notes& notes, int note,
+  const Segment& segment)
 {
-  bend = value * CENTS_RANGE; // Reused with vibrato on
-  int i;
-  for (i = 0; i < MAX_NOTES; ++i)
+  int c = notes.part[note];
+  bool modulating = segment.modulating[c];
+  float target;
+  if (segment.regain[c]) { setGains(notes, note); }
+  // one more pass once modulation stops, to settle ramps back to 0
+  if (!modulating && !segment.ramping[c]) { return; }
+  target = notes.speed[note] * Resample::pitchRatio(segment.mod[c]
+    + channels[c].bend + notes.key[note] - A440_CENTS);
+  notes.ramp[note] = modulating ?
+    (target - notes.increment[note]) * (1.0f / segment.frames) : 0;
+  if (!modulating) { notes.increment[note] = target; }
+}
+
+void WavetableSynth::execute(unsigned part, unsigned parts)
+{
+  int i, s, note,
+    first = (int)(sounding * part / parts),
+    last = (int)(sounding * (part + 1) / parts);
+  float* mix = &mixes[part * MAX_SEGMENTS * BLOCK_FRAMES * OUTPUT_CHANNELS];
+  std::fill(mix, mix + run_frames * OUTPUT_CHANNELS, 0.0f);
+  // each note through every segment, stopping once it finishes
+  for (i = first; i < last; ++i)
+  {
+    note = active[i];
+    for (s = 0; s < segment_count && 0 <= playing.key[note]; ++s)
+    {
+      if (segments[s].update) { modulateNote(playing, note, segments[s]); }
+      renderNote(note, segments[s], mix);
+    }
+  }
+  first = (int)(tailing * part / parts);
+  last = (int)(tailing * (part + 1) / parts);
+  for (i = first; i < last; ++i)
   {
-    playing[i].phase.pitchOffset(bend + playing[i].key - A440_CENTS);
+    note = tail_active[i];
+    for (s = 0; s < segment_count && 0 <= tails.key[note]; ++s)
+    {
+      if (segments[s].update) { modulateNote(tails, note, segments[s]); }
+      renderTail(note, segments[s], mix);
+    }
   }
 }
 
-void WavetableSynth::onVolumeChange(int channel, int level)
+void WavetableSynth::activate(std::vector<int>& active,
+  std::vector<int>& position, int& count, int note)
 {
-  vol = level * RATIO_7BIT;
+  int other = active[count];
+  active[position[note]] = other;
+  position[other] = position[note];
+  active[count] = note;
+  position[note] = count;
+  ++count;
 }
 
-WavetableSynth::WaveData::WaveData(const char* file, float gain,
-  size_t start, size_t end)
-  : source(file), speed(gain), first(start), last(end), channel(0)
+void WavetableSynth::deactivate(std::vector<int>& active,
+  std::vector<int>& position, int& count, int note)
 {
+  int other = active[--count];
+  active[position[note]] = other;
+  position[other] = position[note];
+  active[count] = note;
+  position[note] = count;
 }
 
-WavetableSynth::Note::Note(short midid, float velocity, Voice instr, float rate)
-  : env(0.01f, 600.0f, 0.8f, 4.0f, rate), key(midid), vel(velocity), inst(instr)
+void WavetableSynth::migrate(int note)
 {
-  Play(rate);
+  int tail;
+  if (tailing == (int)tail_active.size()) { return; }
+  tail = tail_active[tailing];
+  activate(tail_active, tail_position, tailing, tail);
+  tails.copy(tail, playing, note);
+  playing.key[note] = -1;
+  playing.vel[note] = 0;
+  deactivate(active, position, sounding, note);
 }
 
-void WavetableSynth::Note::next(void)
+void WavetableSynth::unkey(int note)
 {
-  if (key == -1) { return; }
-  if (env.mode() == ADSR::RELEASE && env.output() < EPSILON)
+  int& index = keyed[playing.part[note]][playing.key[note] / CENTS_SCALE];
+  if (index == note) { index = -1; }
+}
+
+int WavetableSynth::steal(void)
+{
+  int bucket, note;
+  for (bucket = 0; bucket < STEAL_BUCKETS; ++bucket)
   {
-    key = -1;
-    vel = 0;
-    phase.pitchOffset(-25600.0f);
-    return;
+    while (0 <= (note = stealable[bucket]))
+    {
+      stealable[bucket] = next_stealable[note];
+      // skip notes stolen, finished or replaced since they were bucketed
+      if (!bucketed[note] || sounding <= position[note]
+        || playing.key[note] < 0 || playing.mode[note] == ADSR::FADE)
+      {
+        continue;
+      }
+      fade(note);
+      return note;
+    }
   }
-  phase.next();
-  env.next();
+  while (struck_next < struck_count)
+  {
+    note = struck[struck_next++];
+    if (sounding <= position[note] || playing.key[note] < 0
+      || playing.mode[note] == ADSR::FADE) { continue; }
+    fade(note);
+    return note;
+  }
+  return -1;
 }
 
-float WavetableSynth::Note::output(void)
+void WavetableSynth::fade(int note)
 {
-  return phase.output() * env.output() * MIX_DOWN;
+  unkey(note);
+  playing.mode[note] = ADSR::FADE;
+  bucketed[note] = false;
+  faded[(fade_first + fading++) % capacity] = note;
 }
 
-void WavetableSynth::Note::Play(float rate)
+void WavetableSynth::setGains(Notes& notes, int note)
 {
-  switch (inst)
-  {
-  case Grand:
-    if (key < 1600) { SetSound(grand0, rate); return; }
-    if (key < 3200) { SetSound(grand1, rate); return; }
-    if (key < 4800) { SetSound(grand2, rate); return; }
-    if (key < 6400) { SetSound(grand3, rate); return; }
-    if (key < 8000) { SetSound(grand4, rate); return; }
-    if (key < 9600) { SetSound(grand5, rate); return; }
-    if (key < 11200) { SetSound(grand6, rate); return; }
-    else { SetSound(grand7, rate); return; }
-  case Cello:
-    SetSound(cello, rate); return;
-  case Oboe:
-    SetSound(oboe, rate); return;
-  default: return;
-  }
+  const Channel& part = channels[notes.part[note]];
+  float position = part.pan + (notes.key[note] / CENTS_SCALE - CENTER_KEY)
+    * KEY_PAN_SPREAD / CENTER_KEY;
+  float angle = (std::min(std::max(position, -1.0f), 1.0f) + 1) * QUARTER_PI,
+    gain = MIX_DOWN * part.vol * notes.vel[note];
+  notes.left[note] = gain * cos(angle);
+  notes.right[note] = gain * sin(angle);
 }
 
-void WavetableSynth::Note::SetSound(WaveData& data, float sampling_rate)
+void WavetableSynth::setSound(int note, const Keymap::Zone& zone)
 {
-  float rate_offset = sampling_rate / (float)data.source.rate();
-  phase = Resample(&data.source, data.channel, (rate_offset == 0) ? data.speed :
-    data.speed * rate_offset, data.first, data.last);
-  phase.pitchOffset(key - A440_CENTS);
+  float rate_offset = rate / (float)zone.source->rate();
+  playing.source[note] = zone.source;
+  playing.channel[note] = zone.channel;
+  playing.loop_bgn[note] = zone.first;
+  playing.loop_end[note] = zone.last;
+  playing.speed[note] = (rate_offset == 0) ? zone.speed :
+    zone.speed * rate_offset;
+  const Channel& part = channels[playing.part[note]];
+  playing.increment[note] = playing.speed[note]
+    * Resample::pitchRatio(part.mod + part.bend + playing.key[note]
+    - A440_CENTS);
+  playing.ramp[note] = 0;
+  playing.phase[note] = 0;
+  playing.level[note] = 0;
+  playing.mode[note] = ADSR::ATTACK;
 }
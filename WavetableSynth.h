@@ -12,247 +12,707 @@
 #ifndef CS245_WAVETABLESYNTH_H
 #define CS245_WAVETABLESYNTH_H
 
-#include "MidiIn.h" // Base class for inheritance
-#include "AudioData.h" // Member for wavetable of buffered audio file data
-#include "Resample.h" // Member for pitch moderation of AudioData member
+#include "Keymap.h" // Shared bank of zones of sampled audio each note plays
 #include "ADSR.h" // Member for gradual volume changes in sampled note playback
-
-/// Use MidiIn functionality to translate polled midi device to audio output
-class WavetableSynth : private MidiIn {
+#include "EventQueue.h" // Member handing midi events to the render thread
+#include "RenderPool.h" // Member threads splitting sounding notes to render
+#include "LFO.h" // Member oscillator for vibrato modulation
+#include "CpuGovernor.h" // Member stepping render quality to meet deadlines
+#include <memory> // Shared ownership of the immutable sample bank
+#include <vector> // Note slot storage sized for polyphony on construction
+
+/// Translate midi events to audio output. Event callbacks are to be called
+/// from one thread (a SynthInput's, or directly); instances share one sample
+/// bank and may each render on their own thread. Callbacks only queue their
+/// event, timestamped on arrival: render applies it at the sample offset it
+/// arrived at, delayed one block, so events keep their exact spacing.
+/// Channels & 7 bit values are masked into midi range as they're queued
+class WavetableSynth final : private RenderPool::Job {
   public:
+    /// Polyphony capacity used when none is given on construction
+    static const int DEFAULT_NOTES = 256;
+
+    /// Count of interleaved channels (left, right) in rendered output
+    static const int OUTPUT_CHANNELS = 2;
 
     /**
     @brief
-      Initialize audio device for midi polling and sound output
-    @param devno
-      - System enumeration of available midi input devices to read from
+      Initialize note slots for sound output from a (shared) sample bank
+    @param bank
+      - Immutable keymap of zones each program's notes play, shared by every
+      synth constructed against it
     @param R
       - Samples per second used as synthesized wave read speed baseline
+    @param polyphony
+      - Most notes able to sound at once (held and releasing) before stealing
+    @param threads
+      - Count of threads (including the audio callback's) splitting sounding
+      notes between them to render each block
     */
-    WavetableSynth(int devno, int R);
+    WavetableSynth(std::shared_ptr<const Keymap> bank, int R,
+      int polyphony = DEFAULT_NOTES, int threads = 1);
 
     /**
     @brief
-      Stop input polling in preparation to shut down audio output
+      Render the next block of samples from every sounding note into a buffer
+      (notes render in pool runs, flushing denormals to zero on each thread)
+    @param out
+      - Buffer of at least frames * OUTPUT_CHANNELS samples to be overwritten
+      with the interleaved stereo mix
+    @param frames
+      - Number of samples to render; sounding notes are rendered in blocks split
+      at queued events so each lands on its own sample (events are delayed one
+      block from arrival so their spacing is kept exactly)
     */
-    ~WavetableSynth(void);
+    void render(float* out, unsigned long frames);
 
     /**
     @brief
-      Output waveform sample from current patch at current time setting
+      Get how many notes are currently sounding (held or releasing)
     @return
-      - [-1,1] value from active waveform phase offset for audio ouptut
+      - Count of note slots being rendered, out of the polyphony capacity
     */
-    float output(void);
+    int activeNotes(void) const;
 
     /**
     @brief
-      Advance by the current pitch increment to the next output sample
+      Get the quality level rendering has stepped down to meet deadlines
+    @return
+      - Level from CpuGovernor::FULL (0) to CpuGovernor::FEWER_NOTES
     */
-    void next(void);
-
-    /// Container for attributes for a patch to initialize a Note's Resampler
-    struct WaveData
-    {
-      /**
-      @brief
-          Construct container of Resampler initialization attributes
-      @param file
-        - Pointer to the file name/path where AudioData wav file is located on disk
-      @param gain
-        - Gain factor to have the AudioData sound 440 Hz relative to the file contents
-      @param start
-        - First sample used in looped portion of audio data
-      @param end
-        - Last sample used in looped portion of audio data
-      */
-      WaveData(const char* file, float gain, size_t start = 0, size_t end = 0);
+    int qualityLevel(void) const;
 
-      /// Loaded audio file to be resampled in playing a note for the active patch
-      AudioData source;
+    /**
+    @brief
+      Get how many blocks took longer to render than they last
+    @return
+      - Count of blocks rendered past their deadline since construction
+    */
+    unsigned long overruns(void) const;
 
-      /// Which channel a note is effecting (always 0 on this implementation)
-      size_t channel;
+    /**
+    @brief
+      Callback to modulate voice amplitude of vibrato (pitch warble)
+    @param channel
+      - Index for the channel whose vibrato depth is set
+    @param value
+      - Ratio from [0,127] out of 127ths of 200 cent range of vibrato
+    */
+    void onModulationWheelChange(int channel, int value);
 
-      /// Start sample number of audio data for looped portion
-      size_t first;
+    /**
+    @brief
+      Callback to turn note off for the pitch being played
+    @param channel
+      - Index for the channel the note was struck on
+    @param note
+      - Index [0,127] for key enumeration of note to be turned off
+    */
+    void onNoteOff(int channel, int note);
 
-      /// End sample number of audio data for looped portion
-      size_t last;
+    /**
+    @brief
+      Callback to turn note on for the given pitch / velocity
+    @param channel
+      - Index for the channel into which the given note activates
+    @param note
+      - Index [0,127] for key enumeration of note to be turned on
+    @param velocity
+      - Value [0,127] indicative of how hard/loud a note is hit/played
+    */
+    void onNoteOn(int channel, int note, int velocity);
 
-      /// Gain factor to have the AudioData sourced (generally), sound at 440 Hz
-      float speed;
-    };
-  private:
-    static const int MAX_NOTES = 10;
+    /**
+    @brief
+      Callback to change voice for the instrument being played
+    @param channel
+      - Index for the channel into which the given voice changes
+    @param value
+      - [0,127] program selecting the keymap zones new notes play
+    */
+    void onPatchChange(int channel, int value);
 
-    /// Sampled waveform data to use for the current patch / active voice
-    enum Voice
-    {
-      Grand, /// Upright baby grand piano samples
-      Oboe, /// Oboe sample from CS245 class materials
-      Cello, /// Cello sample from CS245 class materials
-      Max, /// Total sampled instruments available
-      Default = Grand, /// Instrument to assign to synth & notes on startup
-    };
+    /**
+    @brief
+      Callback to shift current pitch by up to 200 cents up or down
+    @param channel
+      - Index for the channel into which the pitch wheel modulates notes
+    @param value
+      - [-1,1] range to be mapped into notes' [-200,200] cent pitch shift
+    */
+    void onPitchWheelChange(int channel, float value);
 
-    /// Container for attributes of a note being played
-    struct Note
-    {
-      /**
-      @brief
-          Construct container of attributes tracking a note being played
-      @param midid
-        - [0,127] midi signal identifying linear semitone key progression
-      @param velocity
-        - Ratio of how hard from the possible [0,1] range a note is hit
-      @param instrument
-        - Which patch was active on the instrument when hte note was played
-      @param rate
-        - Sampling rate of the synthesizer
-      */
-      Note(short midid = -1, float velocity = 0, Voice instrument = Default,
-        float rate = 44100.0f);
+    /**
+    @brief
+      Callback to adjust a channel's volume level
+    @param channel
+      - Index for the channel into which the volume is adjusted
+    @param level
+      - [0,127] range value to be mapped onto [0,1] volume ratio
+    */
+    void onVolumeChange(int channel, int level);
 
-      /**
-      @brief
-        Output waveform sample from current patch at current time setting
-      @return
-        - [-1,1] value from active waveform phase offset for audio ouptut
-      */
-      float output(void);
+    /**
+    @brief
+      Callback for other controllers; pan (controller 10) positions a channel
+    @param channel
+      - Index for the channel the controller adjusts
+    @param number
+      - [0,127] controller number
+    @param value
+      - [0,127] controller value; for pan 0 is left, 64 center, 127 right
+    */
+    void onControlChange(int channel, int number, int value);
 
-      /**
-      @brief
-        Advance by the current pitch increment to the next output sample
-      */
-      void next(void);
+  private:
+    /// Most samples rendered per voice pass (modulation is buffered per block)
+    static const int BLOCK_FRAMES = 64;
 
-      /**
-      @brief
-        Set the sound to source for the current instrument (and key where split)
-      @param rate
-        - Sampling rate of the synthesizer
-      */
-      void Play(float rate);
+    /// Most segments of BLOCK_FRAMES rendered per pool run, so threads sync
+    /// once per run (or event) rather than per segment
+    static const int MAX_SEGMENTS = 16;
 
-      /**
-      @brief
-        Set the phase resampler to source the given waveform data of sound to use
-      @param data
-        - Audio data and resampling context for the patch for this note to play
-      @param sampling_rate
-        - Sampling rate of the synthesizer
-      */
-      void SetSound(WaveData& data, float sampling_rate);
+    /// Count of midi channels note events are addressed to
+    static const int MIDI_CHANNELS = 16;
 
-      /// index from midiinput from noteOn call * 100 as a note's ID in cents from A440
-      short key;
+    /// Count of midi key numbers per channel
+    static const int MIDI_KEYS = 128;
 
-      /// Volume for note's midi input velocity value when struck
-      float vel;
+    /// Most events queued between rendered blocks before further are dropped
+    static const unsigned MAX_EVENTS = 1024;
 
-      /// Which voice the note is set to be playing (for note retrigger to carry over)
-      Voice inst;
+    /// Spare note slots past the polyphony limit for stolen notes to fade in
+    static const int STEAL_RESERVE = 16;
 
-      /// Point into waveform data to use as AudioData output
-      Resample phase;
+    /// Stealing priority buckets: released then held, quietest first in each
+    static const int STEAL_BUCKETS = 32;
 
-      /// Amplitude envelope with a balance of control and realism (automated)
-      ADSR env;
+    /// Midi input queued for the render thread
+    struct Event
+    {
+      /// Which callback queued the event
+      enum Type
+      {
+        NoteOn, /// data1 key, data2 velocity
+        NoteOff, /// data1 key
+        PatchChange, /// data1 program
+        PitchWheel, /// value [-1,1] bend
+        Volume, /// data1 level
+        ModulationWheel, /// data1 depth
+        Pan, /// data1 position
+      } type;
+
+      /// Midi channel the event is addressed to
+      short channel;
+
+      /// First midi data value (key, program, level or depth)
+      short data1;
+
+      /// Second midi data value (velocity)
+      short data2;
+
+      /// Continuous value (pitch wheel position)
+      float value;
+
+      /// Steady clock seconds at which the event arrived
+      double time;
     };
 
     /**
     @brief
-      Callback to modulate voice amplitude of vibrato (pitch warble)
+      Map an event's arrival time onto the sample offset it takes effect at
+    @param event
+      - Event queued before the current block began rendering
+    @param frames
+      - Count of samples in the current block being rendered
+    @return
+      - [0, frames) sample offset one block period after the event arrived
+    */
+    unsigned long offset(const Event& event, unsigned long frames) const;
+
+    /**
+    @brief
+      Apply a queued event to synth state (render thread only)
+    @param event
+      - Event popped from the queue
+    */
+    void dispatch(const Event& event);
+
+    /**
+    @brief
+      Set a channel's vibrato depth from the modulation wheel
     @param channel
-      - Index for the channel into which the given note activates (n/a)
+      - Index for the channel whose vibrato depth is set
     @param value
       - Ratio from [0,127] out of 127ths of 200 cent range of vibrato
     */
-    void onModulationWheelChange(int channel, int value) override;
+    void modulationWheelChange(int channel, int value);
 
     /**
     @brief
-      Callback to turn note off for the pitch being played
+      Release the held note for the given channel & key
     @param channel
-      - Index for the channel into which the given note deactivates (n/a)
+      - Index for the channel the note was struck on
     @param note
       - Index [0,127] for key enumeration of note to be turned off
     */
-    void onNoteOff(int channel, int note) override;
+    void noteOff(int channel, int note);
 
     /**
     @brief
-      Callback to turn note on for the given pitch / velocity
+      Strike (or retrigger) a note for the given channel, key & velocity
     @param channel
-      - Index for the channel into which the given note activates (n/a)
+      - Index for the channel into which the given note activates
     @param note
       - Index [0,127] for key enumeration of note to be turned on
     @param velocity
       - Value [0,127] indicative of how hard/loud a note is hit/played
     */
-    void onNoteOn(int channel, int note, int velocity) override;
+    void noteOn(int channel, int note, int velocity);
 
     /**
     @brief
-      Callback to change voice for the instrument being played
+      Change voice new notes on a channel play (O(1); sounding notes keep
+      their zone and release naturally)
     @param channel
-      - Index for the channel into which the given voice changes (n/a)
+      - Index for the channel into which the given voice changes
     @param value
-      - [0,14] value for which Voice enumeration should be selected
+      - [0,127] program selecting the keymap zones new notes play
     */
-    void onPatchChange(int channel, int value) override;
+    void patchChange(int channel, int value);
 
     /**
     @brief
-      Callback to shift current pitch by up to 200 cents up or down
+      Shift pitch of a channel's notes by up to 200 cents up or down
     @param channel
-      - Index for the channel into which the pitch wheel modulates notes (n/a)
+      - Index for the channel into which the pitch wheel modulates notes
     @param value
       - [-1,1] range to be mapped into notes' [-200,200] cent pitch shift
     */
-    void onPitchWheelChange(int channel, float value) override;
+    void pitchWheelChange(int channel, float value);
 
     /**
     @brief
-      Callback to adjust global volume levels
+      Set a channel's volume level
     @param channel
-      - Index for the channel into which the volume is adjusted (n/a)
+      - Index for the channel into which the volume is adjusted
     @param level
       - [0,127] range value to be mapped onto [0,1] volume ratio
     */
-    void onVolumeChange(int channel, int level) override;
+    void volumeChange(int channel, int level);
+
+    /**
+    @brief
+      Set a channel's stereo position
+    @param channel
+      - Index for the channel to position
+    @param value
+      - [0,127] position; 0 is left, 64 center, 127 right
+    */
+    void panChange(int channel, int value);
+
+    /// Controller and patch state of a midi channel, sharing the note slots
+    struct Channel
+    {
+      /// Keymap program new notes on the channel play
+      int patch;
+
+      /// Volume level to be managed by volume change calls
+      float vol;
+
+      /// Scalar of cents per octave for the current pitch bend setting
+      float bend;
+
+      /// Scalar of cents per octave for the current vibrato setting
+      float vibrato;
+
+      /// Scaled cents of the current vibrato setting's phase
+      float mod;
+
+      /// Stereo position [-1,1] the channel's key tracked pan is offset by
+      float pan;
+
+      /// Set when bend or vibrato changed, so sounding notes are retuned
+      bool retune;
+
+      /// Set while the last segment planned ramps any note's increment
+      bool ramping;
+
+      /// Set when volume or pan changed, so sounding notes' gains are reset
+      bool regain;
+    };
+
+    /// Control rate settings of one segment of a pool run, planned up front
+    /// so each thread renders its notes through every segment unsynced
+    struct Segment
+    {
+      /// Offset of the segment's first sample within the run
+      unsigned start;
+
+      /// Count of samples in the segment
+      unsigned frames;
+
+      /// Envelope factors over the segment
+      ADSR::Span span;
+
+      /// Whether any channel needs its sounding notes updated
+      bool update;
+
+      /// Scaled cents of each channel's vibrato phase over the segment
+      float mod[MIDI_CHANNELS];
+
+      /// Per channel, whether notes ramp to vibrato or a changed bend
+      bool modulating[MIDI_CHANNELS];
+
+      /// Per channel, whether the previous segment ramped notes (to settle)
+      bool ramping[MIDI_CHANNELS];
+
+      /// Per channel, whether volume or pan changed, resetting note gains
+      bool regain[MIDI_CHANNELS];
+    };
+
+    /// Structure-of-arrays state per note slot (render loop fields first)
+    struct Notes
+    {
+      /// Fractional frame index into each note's source audio data
+      std::vector<double> phase;
+
+      /// Frames advanced per output sample, pitch offsets included
+      std::vector<float> increment;
+
+      /// Change in increment per sample, ramping pitch across a segment
+      std::vector<float> ramp;
+
+      /// Current amplitude envelope level of each note
+      std::vector<float> level;
+
+      /// Left & right output gains of each note: constant power pan scaled
+      /// by velocity, channel volume and mix down
+      std::vector<float> left, right;
+
+      /// Wavetable audio data each note is resampling
+      std::vector<const AudioData*> source;
+
+      /// Frame subscripts within source audio data bounding looped playback
+      std::vector<unsigned> loop_bgn, loop_end;
+
+      /// Which channel of source audio data each note resamples
+      std::vector<unsigned> channel;
+
+      /// Envelope period each note's level is progressing through
+      std::vector<ADSR::Mode> mode;
+
+      /// Frames advanced per output sample sounding A440 (before pitch offsets)
+      std::vector<float> speed;
+
+      /// index from midiinput from noteOn call * 100 as a note's ID in cents
+      std::vector<short> key;
+
+      /// Volume for note's midi input velocity value when struck
+      std::vector<float> vel;
+
+      /// Midi channel each note was struck on
+      std::vector<short> part;
+
+      /**
+      @brief
+        Allocate every per note array to hold the given count of note slots
+      @param count
+        - Count of note slots for polyphony
+      */
+      void resize(int count);
+
+      /**
+      @brief
+        Copy every attribute of a note slot from another set of notes
+      @param note
+        - Slot index of the note to be overwritten
+      @param from
+        - Notes to copy from
+      @param other
+        - Slot index within from of the note to copy
+      */
+      void copy(int note, const Notes& from, int other);
+    };
+
+    /**
+    @brief
+      Accumulate a note's stereo output for a segment, advancing its envelope
+      at control rate (finishing it once released below audibility)
+    @param note
+      - Slot index of the (sounding) note to render
+    @param segment
+      - Segment of the run to render
+    @param mix
+      - Interleaved stereo buffer of the run, added into at the segment
+    */
+    void renderNote(int note, const Segment& segment, float* mix);
+
+    /**
+    @brief
+      Accumulate a release tail's stereo output for a segment, reading the
+      nearest sample (finishing it once below the culling level)
+    @param note
+      - Slot index of the (sounding) release tail to render
+    @param segment
+      - Segment of the run to render
+    @param mix
+      - Interleaved stereo buffer of the run, added into at the segment
+    */
+    void renderTail(int note, const Segment& segment, float* mix);
+
+    /**
+    @brief
+      Resample & ramp the level of a note into a mono block on the stack,
+      then pan and accumulate it, storing its advanced phase, increment &
+      level
+    @param notes
+      - Note slots (primary or tails) holding the note
+    @param note
+      - Slot index of the note within notes
+    @param target
+      - Envelope level the note ramps linearly to by the end of the segment
+    @param lerp
+      - Whether to interpolate samples rather than read the nearest
+    @param mix
+      - Interleaved stereo buffer of at least frames frames to add into
+    @param frames
+      - Number of frames to render, at most BLOCK_FRAMES
+    */
+    void mixNote(Notes& notes, int note, float target, bool lerp, float* mix,
+      unsigned frames);
+
+    /**
+    @brief
+      Split the samples up to the next event into segments, advancing
+      modulation sources & envelope factors at control rate per segment
+    @param frames
+      - [1, MAX_SEGMENTS * BLOCK_FRAMES] count of samples in the run
+    */
+    void plan(unsigned frames);
+
+    /**
+    @brief
+      Apply a channel's control rate changes for a segment to one of its
+      sounding notes, combining key, bend and vibrato into its pitch and
+      ramping its increment to reach it by the end of the segment
+    @param notes
+      - Note slots (primary or tails) holding the note
+    @param note
+      - Slot index of the note within notes
+    @param segment
+      - Segment about to be rendered
+    */
+    void modulateNote(Notes& notes, int note, const Segment& segment);
+
+    /**
+    @brief
+      Render a contiguous share of the active notes & release tails through
+      every segment of the run into the part's own mix buffer (called
+      concurrently per pool thread)
+    @param part
+      - [0, parts) index of the share of notes to render
+    @param parts
+      - Count of shares the notes are split into
+    */
+    void execute(unsigned part, unsigned parts) override;
+
+    /**
+    @brief
+      Set a note's output gains from its velocity, channel volume and pan
+      offset by its key (low keys left, high keys right)
+    @param notes
+      - Note slots (primary or tails) holding the note
+    @param note
+      - Slot index of the note with key set to be played
+    */
+    void setGains(Notes& notes, int note);
+
+    /**
+    @brief
+      Add a free note slot to the end of an active list of sounding notes
+    @param active
+      - Slot indices: [0, count) are active notes, the remainder are free
+    @param position
+      - Subscript of each note slot within the active list
+    @param count
+      - Count of active notes, incremented
+    @param note
+      - Slot index of the note to start rendering
+    */
+    static void activate(std::vector<int>& active, std::vector<int>& position,
+      int& count, int note);
+
+    /**
+    @brief
+      Swap a sounding note slot out of an active list back into the free pool
+    @param active
+      - Slot indices: [0, count) are active notes, the remainder are free
+    @param position
+      - Subscript of each note slot within the active list
+    @param count
+      - Count of active notes, decremented
+    @param note
+      - Slot index of the note to stop rendering
+    */
+    static void deactivate(std::vector<int>& active, std::vector<int>& position,
+      int& count, int note);
+
+    /**
+    @brief
+      Move a released note into a free release tail slot, freeing its
+      primary slot for new notes (it stays put where no tail slot is free)
+    @param note
+      - Slot index of the primary note entering its release
+    */
+    void migrate(int note);
+
+    /**
+    @brief
+      Clear a note from the channel & key lookup if it is held there
+    @param note
+      - Slot index of a sounding note about to be released, stolen or freed
+    */
+    void unkey(int note);
+
+    /**
+    @brief
+      Start the quietest (released before held) note fading out, taking it
+      from the stealing buckets last filled in rendering, else the oldest
+      note struck since
+    @return
+      - Slot index of the note fading out, else -1 where every note is
+      already fading
+    */
+    int steal(void);
+
+    /**
+    @brief
+      Start a sounding note fading out, unkeyed & appended to the fading list
+    @param note
+      - Slot index of the (not yet fading) note to fade
+    */
+    void fade(int note);
+
+    /**
+    @brief
+      Set a note slot to resample the given waveform data of sound to use,
+      restarting its attack
+    @param note
+      - Slot index of the note with key set to be played
+    @param zone
+      - Audio data and resampling context of the keymap zone the note plays
+    */
+    void setSound(int note, const Keymap::Zone& zone);
+
+    /// Zones of sampled audio each program's notes play, shared between synths
+    std::shared_ptr<const Keymap> keymap;
 
     /// Note attribute settings per key played
-    Note playing[MAX_NOTES];
+    Notes playing;
+
+    /// Released notes, rendered cheaper to keep primary slots free
+    Notes tails;
+
+    /// Tail slot indices: [0, tailing) are sounding, the remainder are free
+    std::vector<int> tail_active;
+
+    /// Subscript of each tail slot within the tail active list
+    std::vector<int> tail_position;
+
+    /// Count of release tails sounding
+    int tailing;
+
+    /// Render time tracking, stepping quality down as blocks near deadlines
+    CpuGovernor governor;
+
+    /// Quality level the block being rendered uses
+    CpuGovernor::Level quality;
+
+    /// Envelope settings shared by every note (state is kept per note)
+    ADSR env;
+
+    /// Slot indices: [0, sounding) are active notes, the remainder are free
+    std::vector<int> active;
+
+    /// Subscript of each note slot within the active list
+    std::vector<int> position;
+
+    /// Count of note slots allocated for polyphony, spares included
+    int capacity;
+
+    /// Count of notes sounding before the quietest is stolen to make room
+    int limit;
+
+    /// First stealable note slot per stealing bucket, else -1
+    int stealable[STEAL_BUCKETS];
+
+    /// Next stealable note slot in the same bucket per note slot, else -1
+    std::vector<int> next_stealable;
+
+    /// Note slots struck since the stealing buckets were filled, oldest
+    /// first, stolen from once the buckets run dry (at most MAX_EVENTS, as
+    /// the buckets are refilled after every run of queued events)
+    std::vector<int> struck;
+
+    /// Count of note slots in struck
+    int struck_count;
+
+    /// Subscript within struck of the next note slot to steal
+    int struck_next;
+
+    /// Count of sounding notes fading out (stolen) among the active notes
+    int fading;
+
+    /// Ring of the fading note slots from faded[fade_first], oldest (so
+    /// furthest faded) first, for note on to cut off once spares run out
+    std::vector<int> faded;
+
+    /// Subscript within faded of the note slot fading longest
+    int fade_first;
+
+    /// Whether each note slot was bucketed in the stealing buckets & still
+    /// holds that note (cleared once it fades or its slot is struck again)
+    std::vector<bool> bucketed;
+
+    /// Slot index of the held (not released) note per channel & key, else -1
+    int keyed[MIDI_CHANNELS][MIDI_KEYS];
+
+    /// Notes struck per channel & key, cycling through round-robin zones
+    unsigned robin[MIDI_CHANNELS][MIDI_KEYS];
+
+    /// Midi events from the input thread waiting for the render thread
+    EventQueue<Event, MAX_EVENTS> events;
+
+    /// Steady clock seconds at which the previous block began rendering
+    double rendered_at;
 
-    /// Scalar of cents per octave for the current pitch bend setting
-    float bend;
+    /// Count of active notes at the front of the active list
+    int sounding;
 
     /// Sampling rate: samples per second for the synthesizer to play
     float rate;
 
-    /// Scalar of cents per octave for the current vibrato setting
-    float vibrato;
+    /// Controller and patch state per midi channel
+    Channel channels[MIDI_CHANNELS];
 
-    /// Scalad cents of the current vibrato setting's phase
-    float mod;
+    /// Oscillator shared by every channel's vibrato, advanced per segment
+    LFO lfo;
 
-    /// Global volume level to be managed by volume change calls
-    float vol;
+    /// Segments of the run being rendered
+    Segment segments[MAX_SEGMENTS];
 
-    /// Fractional index for modulation's sinusoidal phase position
-    double mphase;
+    /// Count of segments in the run being rendered
+    int segment_count;
 
-    /// Fractional phase increment per sample for modulation
-    float dphase;
+    /// Count of samples in the run being rendered
+    unsigned run_frames;
 
-    /// Most recent note index to have had a note turned on
-    int newest;
+    /// Threads rendering shares of the active notes each run
+    RenderPool pool;
 
-    /// Voice type/patch currently being played
-    Voice patch;
+    /// Stereo mix buffer of a run's frames per pool thread, summed in order
+    std::vector<float> mixes;
 
 };
 
@@ -0,0 +1,370 @@
+// WavetableSynthBench.cpp
+// -- headless CPU benchmark for the WavetableSynth class
+// cs245 2024.04
+//
+// usage:
+//   WavetableSynthBench [<voices>] [<rate>] [<frames>] [<threads>]
+// where:
+//   <voices>  -- (optional) polyphony capacity to measure up to (default 256)
+//   <rate>    -- (optional) sampling rate for the synthesizer output
+//   <frames>  -- (optional) frames rendered per block, as in a PortAudio
+//                callback (default 256)
+//   <threads> -- (optional) most render threads to measure scaling up to
+//                (default 1)
+//
+// No MIDI device or audio output is opened: notes are struck directly and
+// blocks are rendered as fast as possible. Voice counts double until the
+// capacity is reached or rendering can no longer keep up with real time.
+// The voice count reached is then rendered with 1 to <threads> threads.
+// The level column is the quality level the CPU governor stepped down to
+// (0 is full quality). Synthetic playing patterns are then rendered block
+// by block for a few seconds each, with their events sent between blocks:
+//   chords  -- dense 12 note chords struck over 4 channels every 100 ms
+//   repeats -- 16 keys each struck again every block, as fast as possible
+//   pads    -- 64 sustained oboe & cello notes with vibrato & pitch bends
+//              sweeping every block
+// reporting the worst block time against the block's real-time budget.
+// Finally release tails are decayed per sample (ADSR.h) far below the
+// synth's culling level, into the denormal range, first directly on the
+// main thread then as a job split between a render pool's threads
+// (RenderPool.h), which flush denormals as the synth's render does, exiting
+// with 1 if pooled block times grow as the tails decay or no level ever went
+// denormal.
+//
+// From the Linux command line:
+//   g++ -O2 WavetableSynthBench.cpp WavetableSynth.cpp AudioData.cpp
+//       Resample.cpp ADSR.cpp RenderPool.cpp LFO.cpp Keymap.cpp CpuGovernor.cpp
+//       DenormalGuard.cpp RealtimeCheck.cpp -pthread
+
+#define _USE_MATH_DEFINES
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cfloat>
+#include <cmath>
+#include <memory>
+#include "WavetableSynth.h"
+#include "RenderPool.h"
+using namespace std;
+
+
+/////////////////////////////////////////////////////////////////
+// Strike notes until the given count of voices are sounding: keys
+// cycle over the 88 piano keys, releasing a key before striking it
+// again so its release tail keeps a voice of its own (attacks are
+// rendered for a moment between passes so tails start audible)
+/////////////////////////////////////////////////////////////////
+void strike(WavetableSynth& synth, int voices, int rate) {
+  const int LOW_KEY = 21, KEYS = 88;
+  vector<float> out(rate / 20 * WavetableSynth::OUTPUT_CHANNELS);
+  for (int i=0; i < voices; ++i) {
+    int key = LOW_KEY + i % KEYS;
+    if (KEYS <= i) {
+      synth.onNoteOff(0, key);
+    }
+    synth.onNoteOn(0, key, 100);
+    if (i % KEYS == KEYS - 1) {
+      synth.render(&out[0], rate / 20);
+    }
+  }
+}
+
+
+/////////////////////////////////////////////////////////////////
+// Render one second of audio, returning seconds spent rendering
+/////////////////////////////////////////////////////////////////
+double measure(WavetableSynth& synth, int rate, unsigned long frames) {
+  vector<float> out(frames * WavetableSynth::OUTPUT_CHANNELS);
+  unsigned long blocks = rate / frames;
+  auto begin = chrono::steady_clock::now();
+  for (unsigned long i=0; i < blocks; ++i) {
+    synth.render(&out[0], frames);
+  }
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - begin;
+  return elapsed.count() * rate / double(blocks * frames);
+}
+
+
+/////////////////////////////////////////////////////////////////
+// Playing patterns sending a block's events ahead of rendering it:
+// synth, block number, frames per block, sampling rate
+/////////////////////////////////////////////////////////////////
+typedef void (*Pattern)(WavetableSynth&, unsigned long, unsigned long, int);
+
+
+/////////////////////////////////////////////////////////////////
+// Dense chords: every 100 ms, release the last chord & strike 12
+// notes on each of 4 channels, roots walking by fifths
+/////////////////////////////////////////////////////////////////
+void chords(WavetableSynth& synth, unsigned long block,
+            unsigned long frames, int rate) {
+  const int CHANNELS = 4, NOTES = 12, LOW_KEY = 24, ROOTS = 48, FIFTH = 7;
+  unsigned long period = max<unsigned long>(rate / 10 / frames, 1);
+  if (block % period) {
+    return;
+  }
+  unsigned long chord = block / period;
+  for (int ch=0; ch < CHANNELS; ++ch) {
+    for (int i=0; chord && i < NOTES; ++i) {
+      synth.onNoteOff(ch, LOW_KEY + (chord - 1) * FIFTH % ROOTS
+                          + ch * NOTES + i);
+    }
+    for (int i=0; i < NOTES; ++i) {
+      synth.onNoteOn(ch, LOW_KEY + chord * FIFTH % ROOTS + ch * NOTES + i,
+                     64 + ch * NOTES + i);
+    }
+  }
+}
+
+
+/////////////////////////////////////////////////////////////////
+// Fast repeated notes: every block, release & strike again each of
+// 16 keys, so retriggers and release tails pile up
+/////////////////////////////////////////////////////////////////
+void repeats(WavetableSynth& synth, unsigned long block, unsigned long,
+             int) {
+  const int KEYS = 16, LOW_KEY = 48;
+  for (int i=0; i < KEYS; ++i) {
+    if (block) {
+      synth.onNoteOff(i % 2, LOW_KEY + i);
+    }
+    synth.onNoteOn(i % 2, LOW_KEY + i, 40 + int((block + i) % 80));
+  }
+}
+
+
+/////////////////////////////////////////////////////////////////
+// Sustained pads: 32 oboe & 32 cello notes held from the first
+// block, with full vibrato & a pitch bend sweeping every block
+/////////////////////////////////////////////////////////////////
+void pads(WavetableSynth& synth, unsigned long block, unsigned long, int) {
+  const int NOTES = 32, LOW_KEY = 36, OBOE = 1, CELLO = 2, SWEEP = 200;
+  if (block == 0) {
+    synth.onPatchChange(OBOE, OBOE);
+    synth.onPatchChange(CELLO, CELLO);
+    synth.onModulationWheelChange(OBOE, 127);
+    synth.onModulationWheelChange(CELLO, 127);
+    for (int i=0; i < NOTES; ++i) {
+      synth.onNoteOn(OBOE, LOW_KEY + i, 90);
+      synth.onNoteOn(CELLO, LOW_KEY + i, 90);
+    }
+  }
+  float bend = float(int(block % SWEEP) - SWEEP / 2) / (SWEEP / 2);
+  synth.onPitchWheelChange(OBOE, bend);
+  synth.onPitchWheelChange(CELLO, -bend);
+}
+
+
+/////////////////////////////////////////////////////////////////
+// Render a few seconds of a playing pattern block by block, then
+// print its realtime factor, ns per voice-sample rendered and the
+// worst block time against the block's real-time budget
+/////////////////////////////////////////////////////////////////
+void stress(const char* label, Pattern pattern, int capacity, int rate,
+            unsigned long frames, const shared_ptr<const Keymap>& bank) {
+  const int SECONDS = 3;
+  WavetableSynth synth(bank, rate, capacity);
+  vector<float> out(frames * WavetableSynth::OUTPUT_CHANNELS);
+  unsigned long blocks = SECONDS * rate / frames;
+  double total = 0, worst = 0, voice_samples = 0;
+  for (unsigned long i=0; i < blocks; ++i) {
+    pattern(synth, i, frames, rate);
+    auto begin = chrono::steady_clock::now();
+    synth.render(&out[0], frames);
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now()
+                                              - begin).count();
+    total += elapsed;
+    worst = max(worst, elapsed);
+    voice_samples += double(synth.activeNotes()) * frames;
+  }
+  double budget = double(frames) / rate;
+  cout << setw(8) << label
+       << setw(12) << fixed << setprecision(2)
+       << blocks * budget / total
+       << setw(17) << setprecision(2)
+       << (voice_samples ? total * 1e9 / voice_samples : 0.0)
+       << setw(16) << setprecision(1) << worst * 1e6
+       << setw(8) << setprecision(0) << worst * 100 / budget << "%"
+       << setw(7) << voice_samples / (double(blocks) * frames)
+       << setw(7) << synth.qualityLevel() << endl;
+}
+
+
+/////////////////////////////////////////////////////////////////
+// Release tails decayed far past the synth's culling level: voices
+// start at levels staggered from full down to 1e-30 and decay by a
+// 1 second release per sample, each mixing a sine cycle scaled by
+// its level into its part's block, so levels pass below FLT_MIN
+// into the denormal range while other voices still sound. Voices
+// are split between the parts of a render pool run
+/////////////////////////////////////////////////////////////////
+class Decay : public RenderPool::Job {
+  public:
+    static const int VOICES = 256, CYCLE = 64;
+
+    Decay(int rate, unsigned long frames_in, unsigned parts)
+      : env(0, 0, 1, RELEASE, float(rate)), frames(frames_in),
+        level(VOICES), mode(VOICES, ADSR::RELEASE), wave(CYCLE),
+        out(parts * frames_in) {
+      for (int v=0; v < VOICES; ++v) {
+        level[v] = pow(10.0f, LOWEST * v / (VOICES - 1));
+      }
+      for (int i=0; i < CYCLE; ++i) {
+        wave[i] = float(sin(2 * M_PI * i / CYCLE));
+      }
+    }
+
+    void execute(unsigned part, unsigned parts) {
+      float *mix = &out[part * frames];
+      fill(mix, mix + frames, 0.0f);
+      for (int v=part; v < VOICES; v += parts) {
+        for (unsigned long f=0; f < frames; ++f) {
+          env.advance(level[v], mode[v]);
+          mix[f] += wave[(f + v) % CYCLE] * level[v];
+        }
+      }
+    }
+
+    // voices still sounding (level above 0)
+    int sounding(void) const {
+      return int(count_if(level.begin(), level.end(),
+                          [](float x) { return 0 < x; }));
+    }
+
+    // voices sounding at denormal levels
+    int denormal(void) const {
+      return int(count_if(level.begin(), level.end(),
+                          [](float x) { return 0 < x && x < FLT_MIN; }));
+    }
+
+  private:
+    static constexpr float RELEASE = 1.0f, LOWEST = -30;
+    ADSR env;
+    unsigned long frames;
+    vector<float> level;
+    vector<ADSR::Mode> mode;
+    vector<float> wave, out;
+};
+
+
+/////////////////////////////////////////////////////////////////
+// Render Decay blocks for several seconds, through a render pool's
+// runs (which flush denormals on every thread) or else directly on
+// this thread. Prints for each second the median block time, the
+// voices still sounding & those at denormal levels. Returns whether
+// every second's median stays within twice the first second's, and
+// sets whether any level went denormal
+/////////////////////////////////////////////////////////////////
+bool decayFlat(RenderPool* pool, int rate, unsigned long frames,
+               bool& reached) {
+  const int SECONDS = 6;
+  const double SLACK = 2.0, NOISE = 2e-6;
+  Decay decay(rate, frames, pool ? pool->threads() : 1);
+  unsigned long blocks = rate / frames;
+  vector<double> times(blocks);
+  double first = 0;
+  bool flat = true;
+  cout << " second  median block us  notes  denormal" << endl;
+  for (int second=0; second < SECONDS; ++second) {
+    for (unsigned long i=0; i < blocks; ++i) {
+      auto begin = chrono::steady_clock::now();
+      if (pool) {
+        pool->run(decay);
+      }
+      else {
+        decay.execute(0, 1);
+      }
+      times[i] = chrono::duration<double>(chrono::steady_clock::now()
+                                          - begin).count();
+    }
+    int denormal = decay.denormal();
+    reached = reached || denormal;
+    nth_element(times.begin(), times.begin() + blocks / 2, times.end());
+    double median = times[blocks / 2];
+    if (second == 0) {
+      first = median;
+    }
+    flat = flat && median <= first * SLACK + NOISE;
+    cout << setw(7) << second
+         << setw(18) << fixed << setprecision(2) << median * 1e6
+         << setw(7) << decay.sounding() << setw(10) << denormal << endl;
+  }
+  cout << "release tails " << (flat ? "flat" : "NOT flat") << endl;
+  return flat;
+}
+
+
+/////////////////////////////////////////////////////////////////
+// Print one row of measurements for a rendered voice count, with
+// the quality level the synth's CPU governor ended at
+/////////////////////////////////////////////////////////////////
+void report(int label, const WavetableSynth& synth, int rate,
+            double seconds) {
+  cout << setw(7) << label
+       << setw(12) << fixed << setprecision(2) << 1.0 / seconds
+       << setw(17) << setprecision(2)
+       << seconds * 1e9 / (double(rate) * synth.activeNotes())
+       << setw(10) << setprecision(1) << seconds * 100 << "%"
+       << setw(8) << synth.qualityLevel() << endl;
+}
+
+
+/////////////////////////////////////////////////////////////////
+//
+/////////////////////////////////////////////////////////////////
+int main(int argc, char *argv[]) {
+  int capacity = (argc > 1) ? atoi(argv[1]) : WavetableSynth::DEFAULT_NOTES;
+  int rate = (argc > 2) ? atoi(argv[2]) : 44100;
+  unsigned long frames = (argc > 3) ? strtoul(argv[3], 0, 10) : 256;
+  int threads = (argc > 4) ? atoi(argv[4]) : 1;
+  if (capacity <= 0 || rate <= 0 || frames == 0 || threads <= 0) {
+    return -1;
+  }
+
+  shared_ptr<const Keymap> bank = make_shared<const Keymap>("keymap.txt");
+  int voices;
+  cout << " voices  realtime x  ns/voice-sample  core load  level" << endl;
+  for (voices=1; ; voices *= 2) {
+    if (capacity < voices) {
+      voices = capacity;
+    }
+    WavetableSynth synth(bank, rate, capacity);
+    strike(synth, voices, rate);
+    double seconds = measure(synth, rate, frames);
+    report(synth.activeNotes(), synth, rate, seconds);
+    if (voices == capacity || seconds > 1) {
+      break;
+    }
+  }
+
+  if (threads > 1) {
+    cout << endl << "threads  realtime x  ns/voice-sample  wall load  level"
+         << endl;
+    for (int n=1; n <= threads; ++n) {
+      WavetableSynth synth(bank, rate, capacity, n);
+      strike(synth, voices, rate);
+      double seconds = measure(synth, rate, frames);
+      report(n, synth, rate, seconds);
+    }
+  }
+
+  cout << endl << " pattern  realtime x  ns/voice-sample  worst block us"
+       << "  budget  notes  level" << endl;
+  stress("chords", chords, capacity, rate, frames, bank);
+  stress("repeats", repeats, capacity, rate, frames, bank);
+  stress("pads", pads, capacity, rate, frames, bank);
+
+  bool reached = false;
+  cout << endl << "direct decay" << endl;
+  decayFlat(nullptr, rate, frames, reached);
+  RenderPool pool(max(threads, 2));
+  cout << endl << "render pool decay" << endl;
+  bool flat = decayFlat(&pool, rate, frames, reached);
+  if (!reached) {
+    cout << "no level reached the denormal range" << endl;
+  }
+  return flat && reached ? 0 : 1;
+}
@@ -9,19 +9,32 @@
 //              If not specified, a list of device is displayed.
 //   <rate>  -- (optional) sampling rate for the synthesizer output
 //
+// Instrument zones are read from keymap.txt in the working directory, with
+// the wav files it names.
+//
 // To compile from the Visual Studio 2015 command prompt:
 //   cl /EHsc /Iinclude WavetableSynthDriver.cpp WavetableSynth.cpp
 //      cs245_proj2.lib portaudio_x86.lib portmidi.lib pthreadVC2.lib
 //
 // From the Linux command line:
 //   g++ -I include WavetableSynthDriver.cpp WavetableSynth.cpp AudioData.cpp
-//       Wave.cpp Resample.cpp MidiIn.cpp ADSR.cpp -lportaudio -lportmidi -pthread
+//       Wave.cpp Resample.cpp MidiIn.cpp ADSR.cpp RenderPool.cpp LFO.cpp
+//       Keymap.cpp CpuGovernor.cpp SynthInput.cpp DenormalGuard.cpp
+//       RealtimeCheck.cpp -lportaudio -lportmidi -pthread
+//
+// Add -DRT_SAFETY_CHECK -ldl -rdynamic (/DRT_SAFETY_CHECK with cl) for a debug
+// build reporting, with stack traces, any allocation, lock, file I/O or throw
+// made while rendering.
 
 #include <iostream>
 #include <algorithm>
 #include <cstdlib>
+#include <memory>
+#include <vector>
 #include <portaudio.h>
 #include "WavetableSynth.h"
+#include "SynthInput.h"
+#include "RealtimeCheck.h"
 using namespace std;
 
 
@@ -33,11 +46,9 @@ int onWrite(const void *vin, void *vout, unsigned long frames,
             PaStreamCallbackFlags flags, void *user) {
   float *out = reinterpret_cast<float*>(vout);
   WavetableSynth& synth = *reinterpret_cast<WavetableSynth*>(user);
+  RT_SAFETY_SCOPE("onWrite");
 
-  for (unsigned long i=0; i < frames; ++i) {
-    out[i] = synth.output();
-    synth.next();
-  }
+  synth.render(out, frames);
 
   return paContinue;
 }
@@ -61,23 +72,29 @@ int main(int argc, char *argv[]) {
 
   int devno = atoi(argv[1]);
   float rate = (argc == 3) ? float(atof(argv[2])) : 44100;
+  shared_ptr<const Keymap> bank;
   WavetableSynth *synth = 0;
+  SynthInput *input = 0;
   try {
-    synth = new WavetableSynth(devno,int(rate));
+    bank = make_shared<const Keymap>("keymap.txt");
+    synth = new WavetableSynth(bank,int(rate));
+    input = new SynthInput(devno,vector<WavetableSynth*>(1,synth));
   }
   catch (exception &e) {
     cout << e.what() << endl;
+    delete synth;
     return -1;
   }
   catch (...) {
     cout << "failed to open device" << endl;
+    delete synth;
     return -1;
   }
 
   Pa_Initialize();
   PaStreamParameters params;
   params.device = Pa_GetDefaultOutputDevice();
-  params.channelCount = 1;
+  params.channelCount = WavetableSynth::OUTPUT_CHANNELS;
   params.sampleFormat = paFloat32;
   params.suggestedLatency = max(0.02,Pa_GetDeviceInfo(params.device)
                                      ->defaultLowOutputLatency);
@@ -91,6 +108,11 @@ int main(int argc, char *argv[]) {
   Pa_StopStream(output_stream);
   Pa_CloseStream(output_stream);
   Pa_Terminate();
+  cout << synth->overruns() << " blocks overran, quality level "
+       << synth->qualityLevel() << endl;
+  cout << "MIDI input latency at most " << input->maxLatency() * 1000
+       << " ms, " << input->unknownMessages() << " unknown messages" << endl;
+  delete input;
   delete synth;
 
   return 0;